@@ -431,7 +431,8 @@ public:
     Label_debugger = -23L,      ///< Protocol ID for the debugger
     Label_smc = -24L,           ///< Protocol ID for ARM SMC calls.
     Label_sched_constraint = -25L, ///< Protocol ID for sched_constraint objects.
-    Max_factory_label = Label_sched_constraint,
+    Label_pi_mutex = -26L,      ///< Protocol ID for priority-inheritance mutexes.
+    Max_factory_label = Label_pi_mutex,
   };
 private:
   Mword _tag;
@@ -110,6 +110,7 @@ Mbwp::init()
 
   Cond_sc *_sc = Cond_sc::create(Ram_quota::root);
   _sc->set_run(true);
+  _sc->set_throttle(true);
   sc.current() = _sc;
 }
 
@@ -181,6 +182,14 @@ Mbwp::handle_period()
   sc.current()->release();
 }
 
+IMPLEMENT_OVERRIDE static
+bool
+Mbwp::throttled()
+{
+  Cond_sc *s = sc.current();
+  return s && !s->can_run();
+}
+
 IMPLEMENT static
 void
 Mbwp::update_stats()
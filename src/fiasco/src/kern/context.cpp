@@ -441,6 +441,7 @@ IMPLEMENTATION:
 #include "timer.h"
 #include "timeout.h"
 #include "sched_constraint.h"
+#include "sched_status.h"
 #include "ready_queue.h"
 
 DEFINE_PER_CPU Per_cpu<Clock> Context::_clock(Per_cpu_data::Cpu_num);
@@ -773,6 +774,7 @@ Context::schedule()
 
   // now, we are sure that a thread on its home CPU calls schedule.
   CNT_SCHEDULE;
+  Sched_status::scheduled();
 
   // Ensure only the current thread calls schedule
   assert (this == current());
@@ -876,11 +878,17 @@ Context::set_sched(Sched_context * const scx)
   _current_scx = scx;
 }
 
+/**
+ * Change the priority of the current Sched_context to `p`.
+ *
+ * A Sched_context blocked by a constraint stays in the blocked list and is
+ * queued at the new priority when it is deblocked.
+ */
 PUBLIC
 void
 Context::change_prio_to(Unsigned8 p)
 {
-  bool do_rq = sched()->is_queued();
+  bool do_rq = sched()->is_queued() && !sched()->blocked_on();
 
   if (do_rq)
     Ready_queue::rq.cpu(home_cpu()).ready_dequeue(sched());
@@ -1156,6 +1164,7 @@ Context::switch_exec_locked(Context *t, enum Helping_mode mode = Not_Helping)
 
   LOG_CONTEXT_SWITCH;
   CNT_CONTEXT_SWITCH;
+  Sched_status::context_switched();
 
   // Can only switch to ready threads!
   // do not consider CPU locality here t can be temporarily migrated
@@ -6,6 +6,7 @@ INTERFACE:
 #include "member_offs.h"
 #include "sender.h"
 #include "context.h"
+#include "sched_constraint.h"
 
 class Ram_quota;
 class Thread;
@@ -48,6 +49,7 @@ public:
   enum Op {
     Op_attach = 0,
     Op_detach = 1,
+    Op_bind_sc  = 2,
     Op_bind     = 0x10,
   };
 
@@ -62,7 +64,24 @@ protected:
   Thread *_irq_thread;
 
 private:
+  /// Delivery deferred by the scheduling constraint.
+  class Sc_deferred : public Sched_constraint::Deferred
+  {
+  public:
+    explicit Sc_deferred(Irq_sender *irq) : _irq(irq) {}
+    void released() override;
+
+  private:
+    Irq_sender *_irq;
+  };
+
   Mword _irq_id;
+
+  /// Optional constraint limiting the delivery rate, holds a reference.
+  Sched_constraint *_sc;
+  /// Time in µs charged to _sc per delivery.
+  Unsigned64 _sc_cost;
+  Sc_deferred _sc_deferred;
 };
 
 
@@ -267,7 +286,8 @@ Irq_sender::free(Kobject ***rl)
 
 PUBLIC explicit
 Irq_sender::Irq_sender(Ram_quota *q = 0)
-: Kobject_h<Irq_sender, Irq>(q), _queued(0), _irq_thread(0), _irq_id(~0UL)
+: Kobject_h<Irq_sender, Irq>(q), _queued(0), _irq_thread(0), _irq_id(~0UL),
+  _sc(0), _sc_cost(0), _sc_deferred(this)
 {
   hit_func = &hit_level_irq;
 }
@@ -289,6 +309,18 @@ Irq_sender::destroy(Kobject ***rl) override
   // existence lock was finally released by the last owner (the existence lock
   // was already invalidated before) -- see also Irq_sender::alloc().
   (void)free(rl);
+
+  // The reference to the constraint is dropped by the destructor, after
+  // the grace period that ends any delivery still using it.
+  if (Sched_constraint *sc = access_once(&_sc))
+    sc->cancel(&_sc_deferred);
+}
+
+PUBLIC
+Irq_sender::~Irq_sender()
+{
+  if (_sc)
+    put_sc(_sc);
 }
 
 
@@ -417,7 +449,78 @@ Irq_sender::send(Thread *t)
 }
 
 
-PUBLIC inline NEEDS[Irq_sender::send, Irq_sender::queue]
+/**
+ * Send the IRQ message unless the scheduling constraint defers it.
+ *
+ * A deferred IRQ stays queued, so that further hits are coalesced, and is
+ * delivered once the constraint allows running again.
+ */
+PRIVATE inline NEEDS[Irq_sender::send]
+void
+Irq_sender::deliver(Thread *t)
+{
+  Sched_constraint *sc = access_once(&_sc);
+  if (EXPECT_FALSE(sc != 0) && !sc->admit(&_sc_deferred, _sc_cost))
+    return;
+
+  send(t);
+}
+
+IMPLEMENT
+void
+Irq_sender::Sc_deferred::released()
+{
+  auto t = access_once(&_irq->_irq_thread);
+  if (EXPECT_TRUE(is_valid_thread(t)) && access_once(&_irq->_queued) > 0)
+    _irq->deliver(t);
+}
+
+/**
+ * Drop the reference of an IRQ to constraint `sc`.
+ */
+PRIVATE static
+void
+Irq_sender::put_sc(Sched_constraint *sc)
+{
+  auto g = lock_guard(cpu_lock);
+
+  sc->dec_ref();
+  if (sc->dying() && sc->ref_cnt() == 0)
+    delete sc;
+}
+
+/**
+ * Bind a scheduling constraint that limits the delivery of this IRQ.
+ *
+ * \param sc    Constraint, nullptr to deliver without limit.
+ * \param cost  Time in µs to charge to `sc` per delivered IRQ message.
+ *
+ * \return The previous constraint, whose reference the caller has to drop
+ *         with put_sc() after an RCU grace period, because deliver() may
+ *         still use it on another CPU.
+ */
+PRIVATE
+Sched_constraint *
+Irq_sender::set_sc(Sched_constraint *sc, Unsigned64 cost)
+{
+  auto g = lock_guard(cpu_lock);
+
+  if (sc)
+    sc->inc_ref();
+
+  Sched_constraint *old;
+  _sc_cost = cost;
+  do
+    old = access_once(&_sc);
+  while (!mp_cas(&_sc, old, sc));
+
+  if (old && old->cancel(&_sc_deferred))
+    _sc_deferred.released();
+
+  return old;
+}
+
+PUBLIC inline NEEDS[Irq_sender::deliver, Irq_sender::queue]
 void
 Irq_sender::_hit_level_irq(Upstream_irq const *ui)
 {
@@ -439,7 +542,7 @@ Irq_sender::_hit_level_irq(Upstream_irq const *ui)
     return;
 
   if (queue() == 0)
-    send(t);
+    deliver(t);
 }
 
 PRIVATE static
@@ -447,7 +550,7 @@ void
 Irq_sender::hit_level_irq(Irq_base *i, Upstream_irq const *ui)
 { nonull_static_cast<Irq_sender*>(i)->_hit_level_irq(ui); }
 
-PUBLIC inline NEEDS[Irq_sender::send, Irq_sender::queue]
+PUBLIC inline NEEDS[Irq_sender::deliver, Irq_sender::queue]
 void
 Irq_sender::_hit_edge_irq(Upstream_irq const *ui)
 {
@@ -482,7 +585,7 @@ Irq_sender::_hit_edge_irq(Upstream_irq const *ui)
 
   Upstream_irq::ack(ui);
   if (q == 0)
-    send(t);
+    deliver(t);
 }
 
 PRIVATE static
@@ -543,6 +646,36 @@ Irq_sender::sys_detach(L4_fpage::Rights rights)
 }
 
 
+PRIVATE
+L4_msg_tag
+Irq_sender::sys_bind_sc(L4_msg_tag tag, L4_fpage::Rights rights,
+                        Utcb const *utcb)
+{
+  if (EXPECT_FALSE(!(rights & L4_fpage::Rights::CS())))
+    return commit_result(-L4_err::EPerm);
+
+  if (EXPECT_FALSE(tag.words() < 2))
+    return commit_result(-L4_err::EInval);
+
+  Sched_constraint *sc = 0;
+  if (tag.items())
+    {
+      Ko::Rights sc_rights;
+      sc = Ko::deref<Sched_constraint>(&tag, utcb, &sc_rights);
+      if (!sc)
+        return tag;
+    }
+
+  Sched_constraint *old = set_sc(sc, access_once(&utcb->values[1]));
+  if (old)
+    {
+      current()->rcu_wait();
+      put_sc(old);
+    }
+
+  return commit_result(0);
+}
+
 PUBLIC
 L4_msg_tag
 Irq_sender::kinvoke(L4_obj_ref, L4_fpage::Rights rights, Syscall_frame *f,
@@ -574,6 +707,9 @@ Irq_sender::kinvoke(L4_obj_ref, L4_fpage::Rights rights, Syscall_frame *f,
         case Op_detach:
           return sys_detach(rights);
 
+        case Op_bind_sc:
+          return sys_bind_sc(tag, rights, utcb);
+
         default:
           return commit_result(-L4_err::ENosys);
         }
@@ -10,6 +10,7 @@ class Mbwp
 public:
   static void init();
   static void handle_period();
+  static bool throttled();
 };
 
 // ------------------------------------------------------------------------
@@ -29,3 +30,11 @@ void
 Mbwp::handle_period()
 {}
 
+/**
+ * Whether the bandwidth throttle currently blocks the current CPU.
+ */
+IMPLEMENT_DEFAULT static
+bool
+Mbwp::throttled()
+{ return false; }
+
@@ -0,0 +1,506 @@
+INTERFACE:
+
+#include "kobject_helper.h"
+#include "prio_list.h"
+#include "slab_cache.h"
+
+class Ram_quota;
+class Space;
+class Thread;
+
+/**
+ * Mutex with priority inheritance.
+ *
+ * The lock state lives in a word in kernel-user memory of the creating
+ * task, so that user level can acquire and release an uncontended mutex
+ * without entering the kernel:
+ *
+ *   0      free
+ *   T      owned by the thread with capability index T, no waiters
+ *   T | W  owned by T, waiters are blocked in the kernel
+ *   W      owned by a thread the kernel handed the mutex to
+ *
+ * User level only ever exchanges 0 and its own T. Threads that fail to
+ * acquire the mutex, and owners that fail to release it because the word
+ * changed, invoke this object. The kernel sets W under the lock of the
+ * wait queue. While there are waiters
+ * the owner runs with the priority of the highest-priority waiter, or with
+ * the ceiling priority if that is higher. Waiters block like on a
+ * semaphore; the owner keeps running on its own Sched_context, so any
+ * time spent in the critical section is charged to the owner's
+ * constraints and not to those of the waiters.
+ *
+ * The mutex only undoes a boost if the owner still runs at the priority
+ * the mutex set. A priority change by someone else while the mutex is held,
+ * e.g. a set_prio() or the boost of another mutex, becomes the new base
+ * priority of the owner and is kept on unlock. There is no boost chain, so
+ * an owner that releases nested boosted mutexes in a different order than
+ * it was boosted by them keeps the priority of the last boost until it
+ * releases the mutex that applied it.
+ */
+class Pi_mutex : public Kobject_h<Pi_mutex>
+{
+  friend class Pi_mutex_test;
+  typedef Slab_cache Self_alloc;
+
+public:
+  enum Op
+  {
+    Op_lock   = 0,
+    Op_unlock = 1,
+  };
+
+  enum : Mword { Waiters = 1 };
+
+private:
+  Ram_quota *_quota;
+  Space *_space;
+  User<Mword>::Ptr _word;
+  Unsigned8 _ceiling;
+
+  /// Owner known to the kernel, holds a reference.
+  Thread *_owner;
+  /// Priority of _owner before it was boosted.
+  Unsigned8 _owner_prio;
+  /// Priority this mutex boosted _owner to, or 0 if it is not boosted.
+  Unsigned8 _boost;
+
+  Locked_prio_list _waiting;
+};
+
+//-----------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include <cstddef>
+
+#include "assert_opt.h"
+#include "cpu_lock.h"
+#include "ipc_timeout.h"
+#include "kmem_slab.h"
+#include "lock_guard.h"
+#include "ram_quota.h"
+#include "sched_context.h"
+#include "space.h"
+#include "thread_object.h"
+#include "thread_state.h"
+
+JDB_DEFINE_TYPENAME(Pi_mutex, "\033[37mPI mutex\033[m");
+
+static Kmem_slab_t<Pi_mutex> _pi_mutex_allocator("Pi_mutex");
+
+PRIVATE static
+Pi_mutex::Self_alloc *
+Pi_mutex::allocator()
+{ return _pi_mutex_allocator.slab(); }
+
+PUBLIC inline
+Pi_mutex::Pi_mutex(Ram_quota *q, Space *s, User<Mword>::Ptr word,
+                   Unsigned8 ceiling)
+: _quota(q), _space(s), _word(word), _ceiling(ceiling), _owner(0),
+  _owner_prio(0), _boost(0)
+{}
+
+PUBLIC inline NEEDS[<cstddef>]
+void *
+Pi_mutex::operator new (size_t, void *b) throw()
+{ return b; }
+
+PUBLIC
+void
+Pi_mutex::operator delete (void *ptr)
+{
+  Pi_mutex *m = reinterpret_cast<Pi_mutex *>(ptr);
+  allocator()->q_free<Ram_quota>(m->_quota, m);
+}
+
+PUBLIC static
+Pi_mutex *
+Pi_mutex::create(Ram_quota *q, Space *s, User<Mword>::Ptr word,
+                 Unsigned8 ceiling)
+{
+  void *p = allocator()->q_alloc<Ram_quota>(q);
+  return p ? new (p) Pi_mutex(q, s, word, ceiling) : 0;
+}
+
+PUBLIC static inline
+Sender *
+Pi_mutex::mutex_partner()
+{ return reinterpret_cast<Sender *>(6); }
+
+/**
+ * Kernel address of the lock word.
+ *
+ * The word is looked up in the kernel-user memory of the calling task on
+ * every use, so a stale task pointer never leads to an access to freed
+ * memory.
+ */
+PRIVATE inline
+Mword *
+Pi_mutex::lock_word(Space *s) const
+{
+  if (EXPECT_FALSE(s != _space))
+    return 0;
+
+  Space::Ku_mem const *m = s->find_ku_mem(_word, sizeof(Mword));
+  return m ? m->kern_addr(_word) : 0;
+}
+
+/// Thread referred to by the owner part of a lock word value.
+PRIVATE static inline
+Thread *
+Pi_mutex::word_owner(Space *s, Mword v)
+{
+  v &= ~Waiters;
+  if (!v)
+    return 0;
+
+  return cxx::dyn_cast<Thread*>(s->lookup_local(L4_obj_ref(v).cap()));
+}
+
+/**
+ * Adapt the priority of the owner to the waiters.
+ *
+ * The ready queue of the owner is only touched if the owner runs on the
+ * current CPU.
+ *
+ * \pre `_waiting.lock()` is held.
+ */
+PRIVATE
+void
+Pi_mutex::boost_owner()
+{
+  Thread *o = _owner;
+  if (!o || (o->state() & Thread_dead) || o->home_cpu() != current_cpu())
+    return;
+
+  // someone else changed the priority since our last boost
+  Unsigned8 cur = o->sched()->prio();
+  if (cur != _boost)
+    _owner_prio = cur;
+
+  Unsigned8 p = _owner_prio;
+  if (Prio_list_elem *f = _waiting.first())
+    {
+      if (f->prio() > p)
+        p = f->prio();
+      if (_ceiling > p)
+        p = _ceiling;
+    }
+
+  if (cur != p)
+    o->change_prio_to(p);
+
+  _boost = p != _owner_prio ? p : 0;
+}
+
+/**
+ * Make `t` the owner known to the kernel.
+ *
+ * \pre `_waiting.lock()` is held.
+ * \return The previous owner, whose reference the caller has to drop.
+ */
+PRIVATE
+Thread *
+Pi_mutex::set_owner(Thread *t)
+{
+  Thread *old = _owner;
+  if (old && _boost && !(old->state() & Thread_dead)
+      && old->home_cpu() == current_cpu()
+      && old->sched()->prio() == _boost)
+    old->change_prio_to(_owner_prio);
+
+  _boost = 0;
+  if (t)
+    {
+      t->inc_ref();
+      _owner_prio = t->sched()->prio();
+    }
+
+  _owner = t;
+  boost_owner();
+  return old;
+}
+
+PRIVATE static
+void
+Pi_mutex::put_owner(Thread *t)
+{
+  if (!t)
+    return;
+
+  Kobject::Reap_list r;
+  t->put_n_reap(r.list());
+  if (EXPECT_FALSE(!r.empty()))
+    {
+      auto l = lock_guard<Lock_guard_inverse_policy>(cpu_lock);
+      r.del_1();
+    }
+}
+
+/**
+ * Acquire the mutex or enqueue the current thread.
+ *
+ * \return 0 if the mutex was acquired, 1 if the thread has to block,
+ *         <0 on error.
+ */
+PRIVATE
+int
+Pi_mutex::lock(Thread *ct, Mword *w, Thread **put)
+{
+  auto g = lock_guard(_waiting.lock());
+
+  Mword v;
+  for (;;)
+    {
+      v = access_once(w);
+      if (v == 0)
+        {
+          if (!mp_cas(w, Mword(0), Mword(Waiters)))
+            continue;
+
+          *put = set_owner(ct);
+          return 0;
+        }
+
+      if ((v & Waiters) || mp_cas(w, v, v | Waiters))
+        break;
+    }
+
+  if (!_owner)
+    {
+      Thread *o = word_owner(ct->space(), v);
+      if (!o)
+        return -L4_err::EInval;
+
+      *put = set_owner(o);
+    }
+
+  if (EXPECT_FALSE(_owner == ct))
+    return -L4_err::EBusy;
+
+  ct->set_partner(mutex_partner());
+  ct->state_change_dirty(~Thread_ready, Thread_receive_wait);
+  ct->set_wait_queue(&_waiting);
+  ct->sender_enqueue(&_waiting, ct->sched()->prio());
+  boost_owner();
+  return 1;
+}
+
+PRIVATE inline NEEDS["assert_opt.h", "ipc_timeout.h"]
+L4_msg_tag
+Pi_mutex::sys_lock(L4_fpage::Rights rights, L4_timeout t, Utcb const *utcb)
+{
+  if (EXPECT_FALSE(!(rights & L4_fpage::Rights::CS())))
+    return commit_result(-L4_err::EPerm);
+
+  Thread *const c_thread = ::current_thread();
+  assert_opt (c_thread);
+
+  Mword *w = lock_word(c_thread->space());
+  if (EXPECT_FALSE(!w))
+    return commit_result(-L4_err::EInval);
+
+  enum
+  {
+    Thread_wait_mask = Thread_cancel | Thread_timeout
+                       | Thread_receive_wait
+  };
+
+  Thread *put = 0;
+  int r = lock(c_thread, w, &put);
+  put_owner(put);
+
+  if (r <= 0)
+    return commit_result(r);
+
+  IPC_timeout timeout;
+
+  if (!(c_thread->state() & Thread_ready))
+    c_thread->setup_timer(t, utcb, &timeout);
+
+  while (!(c_thread->state() & Thread_ready))
+    c_thread->schedule();
+
+  c_thread->reset_timeout();
+
+  Mword s = c_thread->state();
+  if (s & Thread_wait_mask)
+    c_thread->state_del_dirty(Thread_wait_mask);
+
+  if (EXPECT_FALSE(c_thread->in_sender_list()))
+    {
+      auto g = lock_guard(_waiting.lock());
+      c_thread->set_partner(0);
+      c_thread->set_wait_queue(0);
+      c_thread->sender_dequeue(&_waiting);
+      boost_owner();
+    }
+  else if (!(s & Thread_cancel))
+    // unlock() made us the owner
+    return commit_result(0);
+
+  return commit_error(utcb, (s & Thread_cancel) ? L4_error::R_canceled
+                                                : L4_error::R_timeout);
+}
+
+/**
+ * Release the mutex held by `ct` and hand it to the first waiter, if any.
+ *
+ * \param[out] wakeup  The waiter that became the owner and that the caller
+ *                     has to activate, or 0.
+ *
+ * \return 0 on success, <0 on error.
+ */
+PRIVATE
+int
+Pi_mutex::unlock(Thread *ct, Mword *w, Thread **put, Thread **wakeup)
+{
+  auto g = lock_guard(_waiting.lock());
+  Mword v = access_once(w);
+
+  // An owner that acquired the mutex at user level is not known to the
+  // kernel if looking it up failed in lock().
+  if (_owner != ct
+      && (_owner || !v || word_owner(ct->space(), v) != ct))
+    return -L4_err::EPerm;
+
+  if (Prio_list_elem *f = _waiting.first())
+    {
+      _waiting.dequeue(f);
+      Thread *t = static_cast<Thread*>(Sender::cast(f));
+      t->set_wait_queue(0);
+      t->xcpu_state_change(~(Thread_cancel | Thread_timeout), 0UL);
+      write_now(w, Mword(Waiters));
+      *put = set_owner(t);
+      *wakeup = t;
+    }
+  else
+    {
+      write_now(w, Mword(0));
+      *put = set_owner(0);
+    }
+
+  return 0;
+}
+
+PRIVATE
+L4_msg_tag
+Pi_mutex::sys_unlock(L4_fpage::Rights rights)
+{
+  if (EXPECT_FALSE(!(rights & L4_fpage::Rights::CS())))
+    return commit_result(-L4_err::EPerm);
+
+  Thread *const c_thread = ::current_thread();
+  assert_opt (c_thread);
+
+  Mword *w = lock_word(c_thread->space());
+  if (EXPECT_FALSE(!w))
+    return commit_result(-L4_err::EInval);
+
+  Thread *put = 0;
+  Thread *wakeup = 0;
+  int r = unlock(c_thread, w, &put, &wakeup);
+  put_owner(put);
+
+  if (wakeup)
+    wakeup->activate();
+
+  return commit_result(r);
+}
+
+PUBLIC
+L4_msg_tag
+Pi_mutex::kinvoke(L4_obj_ref, L4_fpage::Rights rights, Syscall_frame *f,
+                  Utcb const *utcb, Utcb *)
+{
+  L4_msg_tag tag = f->tag();
+
+  if (EXPECT_FALSE(tag.proto() != L4_msg_tag::Label_pi_mutex))
+    return commit_result(-L4_err::EBadproto);
+
+  if (EXPECT_FALSE(tag.words() < 1))
+    return commit_result(-L4_err::EInval);
+
+  switch (utcb->values[0])
+    {
+    case Op_lock:
+      return sys_lock(rights, f->timeout().rcv, utcb);
+    case Op_unlock:
+      return sys_unlock(rights);
+    default:
+      return commit_result(-L4_err::ENosys);
+    }
+}
+
+/// Wake all waiters, they return with a cancel error.
+PRIVATE
+void
+Pi_mutex::cancel_all()
+{
+  while (Prio_list_elem *h = _waiting.first())
+    {
+      auto g1 = lock_guard(cpu_lock);
+      Thread *w;
+        {
+          auto g2 = lock_guard(_waiting.lock());
+          if (EXPECT_FALSE(h != _waiting.first()))
+            continue;
+
+          w = static_cast<Thread*>(Sender::cast(h));
+          _waiting.dequeue(h);
+          w->set_wait_queue(0);
+          w->xcpu_state_change(~0UL, Thread_cancel);
+        }
+      w->activate();
+    }
+}
+
+PUBLIC
+void
+Pi_mutex::destroy(Kobject ***rl) override
+{
+  Kobject::destroy(rl);
+  cancel_all();
+
+  Thread *o;
+    {
+      auto g = lock_guard(_waiting.lock());
+      o = set_owner(0);
+    }
+
+  if (o)
+    o->put_n_reap(rl);
+}
+
+namespace {
+static Kobject_iface * FIASCO_FLATTEN
+pi_mutex_factory(Ram_quota *q, Space *s, L4_msg_tag t, Utcb const *u,
+                 int *err)
+{
+  if (t.words() < 3)
+    {
+      *err = L4_err::EInval;
+      return nullptr;
+    }
+
+  User<Mword>::Ptr word(reinterpret_cast<Mword *>(u->values[2]));
+  Unsigned8 ceiling = 0;
+  if (t.words() >= 5)
+    ceiling = u->values[4];
+
+  if (!s->find_ku_mem(word, sizeof(Mword)))
+    {
+      *err = L4_err::EInval;
+      return nullptr;
+    }
+
+  *err = L4_err::ENomem;
+  return Pi_mutex::create(q, s, word, ceiling);
+}
+
+static inline void __attribute__((constructor)) FIASCO_INIT
+register_factory()
+{
+  Kobject_iface::set_factory(L4_msg_tag::Label_pi_mutex, pi_mutex_factory);
+}
+}
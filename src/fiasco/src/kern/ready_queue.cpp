@@ -12,12 +12,28 @@ INTERFACE:
 #include <cstdio>
 
 class Mbw_sc;
+class Group_sc;
 
 class Ready_queue
 {
+  friend class Ready_queue_test;
+
 public:
   static Per_cpu<Ready_queue> rq;
   static constexpr auto priorities { 256 };
+  static constexpr auto bands { 8 };
+  /// Maximum number of ready Sched_contexts in the heap of EDF and
+  /// fair-share bands. Further ones wait in the fixed-priority queue of
+  /// their priority until there is room.
+  static constexpr auto heap_max { 256 };
+
+  /// How the Sched_contexts of a priority band are ordered.
+  enum Band_policy
+  {
+    Fixed_prio = 0,
+    Edf        = 1,
+    Fair       = 2,
+  };
   int _c = 0;
 
   void enqueue(Sched_context *, bool);
@@ -29,6 +45,21 @@ public:
   Sched_context *current() const { return _current; }
   void invalidate_current() { activate(nullptr); }
 
+  /// Number of ready Sched_contexts in priority band `b`.
+  Mword ready_in_band(unsigned b) const { return _band_len[b]; }
+
+  static unsigned band(unsigned prio) { return prio / (priorities / bands); }
+
+  /// Whether priority band `b` is scheduled earliest deadline first.
+  bool is_edf(unsigned b) const { return _edf_bands & (1U << b); }
+
+  /// Whether priority band `b` is scheduled by weighted fair share.
+  bool is_fair(unsigned b) const { return _fair_bands & (1U << b); }
+
+  /// Whether the Sched_contexts of band `b` are kept in the heap.
+  bool in_heap(unsigned b) const
+  { return (_edf_bands | _fair_bands) & (1U << b); }
+
   void set_current(Sched_context *);
   bool deblock(Sched_context *, Sched_context *, bool = false);
 
@@ -79,6 +110,22 @@ private:
   typedef cxx::Sd_list<Sched_context> Queue;
   Unsigned8 prio_highest { 0 };
   Queue queue[priorities];
+  Mword _band_len[bands] = { 0 };
+
+  /// Bands scheduled earliest deadline first.
+  Unsigned8 _edf_bands = 0;
+  /// Bands scheduled by weighted fair share.
+  Unsigned8 _fair_bands = 0;
+  /// Virtual run time of the most recently charged Sched_context per
+  /// fair-share band. Sched_contexts that become ready start no earlier.
+  Unsigned64 _fair_clock[bands] = { 0 };
+  /// Generation of the virtual time per fair-share band, advanced whenever
+  /// the band policy and with it _fair_clock is reset.
+  Mword _fair_gen[bands] = { 0 };
+  unsigned _heap_cnt = 0;
+  /// Ready Sched_contexts of all EDF and fair-share bands, highest band and
+  /// smallest key on top.
+  Sched_context *_heap[heap_max];
 
   Sched_context *_current;
 };
@@ -99,22 +146,342 @@ private:
 IMPLEMENTATION:
 
 #include "cpu_lock.h"
+#include "l4_types.h"
 #include "panic.h"
 #include "std_macros.h"
 #include "logdefs.h"
 #include "sched_constraint.h"
+#include "sched_status.h"
+#include "timer.h"
 
 #include <cassert>
 
 DEFINE_PER_CPU Per_cpu<Ready_queue> Ready_queue::rq;
 
+/**
+ * EDF and fair-share bands are scheduled as a whole above all lower and
+ * below all higher bands. Fixed-priority bands never share an index with
+ * them, so comparing the bands is enough. Only the overflow of the heap of
+ * a band shares its index; it runs after the entries in the heap.
+ */
 IMPLEMENT inline
 Sched_context *
 Ready_queue::next_to_run() const
-{ return queue[prio_highest].front(); }
+{
+  if (EXPECT_FALSE(_heap_cnt)
+      && band(_heap[0]->queue_prio()) >= band(prio_highest))
+    return _heap[0];
+
+  return queue[prio_highest].front();
+}
+
+/**
+ * Select how the Sched_contexts of band `b` are ordered.
+ *
+ * \param b       Priority band.
+ * \param policy  A Band_policy.
+ *
+ * \retval 0                Success.
+ * \retval -L4_err::EInval  `b` is out of range or the idle band 0, or
+ *                          `policy` is unknown.
+ * \retval -L4_err::EBusy   A Sched_context is ready in band `b`.
+ */
+PUBLIC
+int
+Ready_queue::set_band_policy(Mword b, Mword policy)
+{
+  assert(cpu_lock.test());
+
+  if (b == 0 || b >= bands || policy > Fair)
+    return -L4_err::EInval;
+
+  Unsigned8 bit = 1U << b;
+  Unsigned8 edf = policy == Edf ? bit : 0;
+  Unsigned8 fair = policy == Fair ? bit : 0;
+
+  if ((_edf_bands & bit) == edf && (_fair_bands & bit) == fair)
+    return 0;
+
+  if (_band_len[b])
+    return -L4_err::EBusy;
+
+  _edf_bands = (_edf_bands & ~bit) | edf;
+  _fair_bands = (_fair_bands & ~bit) | fair;
+  _fair_clock[b] = 0;
+  ++_fair_gen[b];
+
+  return 0;
+}
+
+/**
+ * Virtual run time `vr` of `scx` in fair-share band `b`, relative to the
+ * virtual time of the band on this CPU.
+ *
+ * A run time that is an offset left by fair_migrate_away() is put on top of
+ * the band's virtual time. A run time of another CPU or of an earlier
+ * generation of the band is meaningless here and dropped.
+ */
+PRIVATE inline
+Unsigned64
+Ready_queue::fair_vruntime(Sched_context const *scx, Unsigned64 vr,
+                           unsigned b) const
+{
+  if (!scx->_vruntime_rq)
+    vr += _fair_clock[b];
+  else if (scx->_vruntime_rq != this || scx->_vruntime_gen != _fair_gen[b])
+    vr = 0;
+
+  return vr < _fair_clock[b] ? _fair_clock[b] : vr;
+}
+
+/**
+ * Turn the virtual run time of `scx` into an offset from the virtual time
+ * of its band before `scx` leaves this CPU.
+ *
+ * The next ready queue puts the offset on top of its own virtual time, so
+ * that `scx` keeps its lag instead of the difference between the clocks.
+ *
+ * \pre `scx` is not ready on this CPU.
+ */
+PUBLIC
+void
+Ready_queue::fair_migrate_away(Sched_context *scx) const
+{
+  unsigned b = band(scx->queue_prio());
+  Unsigned64 vr = fair_vruntime(scx, scx->_vruntime, b);
+
+  scx->_vruntime = vr - _fair_clock[b];
+  scx->_vruntime_rq = nullptr;
+}
+
+/**
+ * Key of `scx` in the heap.
+ *
+ * A Sched_context that waited in a fair-share band is moved up to the
+ * virtual time of the band, so that it does not claim the time it did not
+ * use.
+ */
+PRIVATE
+Unsigned64
+Ready_queue::heap_key(Sched_context *scx)
+{
+  unsigned b = band(scx->queue_prio());
+
+  if (!is_fair(b))
+    return scx->edf_deadline();
+
+  scx->_vruntime = fair_vruntime(scx, scx->_vruntime, b);
+  scx->_vruntime_rq = this;
+  scx->_vruntime_gen = _fair_gen[b];
+
+  return scx->_vruntime;
+}
+
+/**
+ * Key `scx` is or would be ordered by in the heap, without changing it.
+ *
+ * For the current Sched_context of a fair-share band, the run time not
+ * charged yet is included.
+ */
+PUBLIC
+Unsigned64
+Ready_queue::peek_key(Sched_context const *scx) const
+{
+  unsigned b = band(scx->queue_prio());
+
+  if (!is_fair(b))
+    return scx->edf_deadline();
+
+  Unsigned64 vr = scx == _current ? scx->vruntime_at(Timer::system_clock())
+                                  : scx->_vruntime;
+  return fair_vruntime(scx, vr, b);
+}
+
+/**
+ * Charge the run time of `scx` in a fair-share band up to `now`.
+ */
+PRIVATE
+void
+Ready_queue::fair_charge(Sched_context *scx, Unsigned64 now)
+{
+  unsigned b = band(scx->queue_prio());
+  Unsigned64 vr = scx->charge_vruntime(now);
+
+  if (vr > _fair_clock[b])
+    _fair_clock[b] = vr;
+
+  if (scx->_heap_pos != Sched_context::Heap_none)
+    {
+      scx->_key = scx->_vruntime;
+      heap_fix(scx->_heap_pos);
+    }
+}
+
+PRIVATE inline
+bool
+Ready_queue::heap_before(Sched_context const *a, Sched_context const *b) const
+{
+  unsigned ba = band(a->queue_prio());
+  unsigned bb = band(b->queue_prio());
+  return ba > bb || (ba == bb && a->_key < b->_key);
+}
+
+PRIVATE inline
+void
+Ready_queue::heap_set(unsigned pos, Sched_context *scx)
+{
+  _heap[pos] = scx;
+  scx->_heap_pos = pos;
+}
+
+PRIVATE
+void
+Ready_queue::heap_up(unsigned pos)
+{
+  Sched_context *scx = _heap[pos];
+  while (pos > 0)
+    {
+      unsigned p = (pos - 1) / 2;
+      if (!heap_before(scx, _heap[p]))
+        break;
+
+      heap_set(pos, _heap[p]);
+      pos = p;
+    }
+
+  heap_set(pos, scx);
+}
+
+PRIVATE
+void
+Ready_queue::heap_down(unsigned pos)
+{
+  Sched_context *scx = _heap[pos];
+  for (;;)
+    {
+      unsigned c = 2 * pos + 1;
+      if (c >= _heap_cnt)
+        break;
+
+      if (c + 1 < _heap_cnt && heap_before(_heap[c + 1], _heap[c]))
+        ++c;
+
+      if (!heap_before(_heap[c], scx))
+        break;
+
+      heap_set(pos, _heap[c]);
+      pos = c;
+    }
+
+  heap_set(pos, scx);
+}
+
+/**
+ * Restore the heap order after the key at `pos` changed.
+ */
+PRIVATE inline
+void
+Ready_queue::heap_fix(unsigned pos)
+{
+  if (pos > 0 && heap_before(_heap[pos], _heap[(pos - 1) / 2]))
+    heap_up(pos);
+  else
+    heap_down(pos);
+}
+
+PRIVATE
+void
+Ready_queue::heap_insert(Sched_context *scx)
+{
+  assert(_heap_cnt < heap_max);
+
+  scx->_key = heap_key(scx);
+  unsigned pos = _heap_cnt++;
+  heap_set(pos, scx);
+  heap_up(pos);
+}
+
+PRIVATE
+void
+Ready_queue::heap_remove(Sched_context *scx)
+{
+  unsigned pos = scx->_heap_pos;
+  scx->_heap_pos = Sched_context::Heap_none;
+
+  if (pos == --_heap_cnt)
+    return;
+
+  heap_set(pos, _heap[_heap_cnt]);
+  heap_fix(pos);
+}
+
+PRIVATE inline
+void
+Ready_queue::queue_insert(Sched_context *scx, Unsigned8 prio, bool is_current)
+{
+  ++_band_len[band(prio)];
+
+  if (in_heap(band(prio)) && EXPECT_TRUE(_heap_cnt < heap_max))
+    {
+      heap_insert(scx);
+      return;
+    }
+
+  if (prio > prio_highest)
+    prio_highest = prio;
+
+  queue[prio].push(scx, is_current? Queue::Front : Queue::Back);
+}
+
+PRIVATE inline
+void
+Ready_queue::queue_remove(Sched_context *scx, Unsigned8 prio)
+{
+  --_band_len[band(prio)];
+
+  if (scx->_heap_pos != Sched_context::Heap_none)
+    {
+      heap_remove(scx);
+      return;
+    }
+
+  queue[prio].remove(scx);
+
+  while (queue[prio_highest].empty() && prio_highest)
+    prio_highest--;
+}
+
+/**
+ * Put `to` at the position of `from` in the queue of priority `prio`.
+ */
+PRIVATE inline
+void
+Ready_queue::queue_replace(Sched_context *from, Sched_context *to,
+                           Unsigned8 prio)
+{
+  if (from->_heap_pos != Sched_context::Heap_none)
+    {
+      unsigned pos = from->_heap_pos;
+      from->_heap_pos = Sched_context::Heap_none;
+      to->_key = heap_key(to);
+      heap_set(pos, to);
+      heap_fix(pos);
+      return;
+    }
+
+  Queue::insert_before(to, Queue::iter(from));
+  if (queue[prio].front() == from)
+    queue[prio].rotate_to(to);
+  queue[prio].remove(from);
+}
 
 /**
  * Enqueue sched_context in ready-list.
+ *
+ * A member of a group that is served by this queue only enters the queue if
+ * it is the most important ready member of a group that may run. It then
+ * represents the whole group at the priority of the group. All other ready
+ * members wait in the local queue of the group.
  */
 IMPLEMENT
 void
@@ -126,12 +493,26 @@ Ready_queue::enqueue(Sched_context *scx, bool is_current)
   if (EXPECT_FALSE (scx->is_queued()))
     return;
 
-  Unsigned8 prio = scx->prio();
-
-  if (prio > prio_highest)
-    prio_highest = prio;
-
-  queue[prio].push(scx, is_current? Queue::Front : Queue::Back);
+  Group_sc *g = scx->group();
+  if (g && g->rq() == this)
+    {
+      Sched_context *head = g->head();
+      if (!g->can_run() || (head && !scx->dominates(head)))
+        {
+          g->local_enqueue(scx, is_current);
+          return;
+        }
+
+      g->set_head(scx);
+      if (head)
+        {
+          queue_replace(head, scx, g->prio());
+          g->local_enqueue(head, true);
+          return;
+        }
+    }
+
+  queue_insert(scx, scx->queue_prio(), is_current);
 
   //_c++;
   if (M_SCHEDULER_DEBUG) printf("SCHEDULER> RQ[addr: %p, entries: %d]: enqueue SCX[%p]\n", this, _c, scx);
@@ -139,8 +520,11 @@ Ready_queue::enqueue(Sched_context *scx, bool is_current)
 
 /**
  * Remove context from ready-list.
+ *
+ * If `scx` represents its group, the next member of the group takes its
+ * place.
  */
-IMPLEMENT inline NEEDS ["cpu_lock.h", <cassert>, "std_macros.h"]
+IMPLEMENT
 void
 Ready_queue::dequeue(Sched_context *scx)
 {
@@ -150,25 +534,133 @@ Ready_queue::dequeue(Sched_context *scx)
   if (EXPECT_FALSE (!scx->is_queued()))
     return;
 
-  Unsigned8 prio = scx->prio();
-
-  queue[prio].remove(scx);
-
-  while (queue[prio_highest].empty() && prio_highest)
-    prio_highest--;
+  Group_sc *g = scx->group();
+  if (g && g->rq() == this)
+    {
+      if (scx != g->head())
+        {
+          g->local_dequeue(scx);
+          return;
+        }
+
+      Sched_context *next = g->local_next();
+      if (next)
+        {
+          g->local_dequeue(next);
+          g->set_head(next);
+          queue_replace(scx, next, g->prio());
+          return;
+        }
+
+      g->set_head(nullptr);
+    }
+
+  queue_remove(scx, scx->queue_prio());
   //_c--;
   if (M_SCHEDULER_DEBUG) printf("SCHEDULER> RQ[addr: %p, entries: %d]: dequeue SCX[%p]\n", this, _c, scx);
 }
-      
-      
-PUBLIC inline
+
+/**
+ * Move `scx` behind the other ready Sched_contexts of its priority.
+ *
+ * A member of a group is rotated among the members of the same priority
+ * in its group, and the group among the entries of the group priority.
+ */
+PUBLIC
 void
 Ready_queue::requeue(Sched_context *scx)
 {
   if (!scx->is_queued())
-    enqueue(scx, false);
-  else
-    queue[scx->prio()].rotate_to(*++Queue::iter(scx));
+    {
+      enqueue(scx, false);
+      return;
+    }
+
+  Group_sc *g = scx->group();
+  if (g && g->rq() == this)
+    {
+      if (scx != g->head())
+        {
+          g->local_requeue(scx);
+          return;
+        }
+
+      Sched_context *next = g->local_next();
+      if (next && next->prio() == scx->prio())
+        {
+          g->local_dequeue(next);
+          g->set_head(next);
+          queue_replace(scx, next, g->prio());
+          g->local_enqueue(scx, false);
+          scx = next;
+        }
+    }
+
+  if (scx->_heap_pos != Sched_context::Heap_none)
+    {
+      if (scx == _current && is_fair(band(scx->queue_prio())))
+        fair_charge(scx, Timer::system_clock());
+
+      // the deadline may have moved on with a new period
+      scx->_key = heap_key(scx);
+      heap_fix(scx->_heap_pos);
+      return;
+    }
+
+  Unsigned8 prio = scx->queue_prio();
+  if (EXPECT_FALSE(in_heap(band(prio))) && _heap_cnt < heap_max)
+    {
+      // overflow of a full heap, move it to the heap now that there is room
+      queue_remove(scx, prio);
+      queue_insert(scx, prio, false);
+      return;
+    }
+
+  queue[prio].rotate_to(*++Queue::iter(scx));
+}
+
+/**
+ * Take a group out of the ready queue, because it may not run.
+ *
+ * The member representing the group goes back to the local queue of the
+ * group, so that all members leave the ready queue at once.
+ */
+PUBLIC
+void
+Ready_queue::group_suspend(Group_sc *g)
+{
+  assert(cpu_lock.test());
+  assert(g->rq() == this);
+
+  Sched_context *head = g->head();
+  if (!head)
+    return;
+
+  queue_remove(head, g->prio());
+  g->set_head(nullptr);
+  g->local_enqueue(head, true);
+}
+
+/**
+ * Put a group that may run again back into the ready queue.
+ */
+PUBLIC
+void
+Ready_queue::group_resume(Group_sc *g)
+{
+  assert(cpu_lock.test());
+  assert(g->rq() == this);
+
+  if (g->head() || !g->can_run())
+    return;
+
+  Sched_context *next = g->local_next();
+  if (!next)
+    return;
+
+  g->local_dequeue(next);
+  g->set_head(next);
+  queue_insert(next, g->prio(), false);
 }
       
 PUBLIC inline
@@ -225,12 +717,19 @@ Ready_queue::set_current(Sched_context *scx)
   ////tt->set(clock + scx->left, current_cpu());
 
   // Make this timeslice current
+  Unsigned64 now = Timer::system_clock();
   if (_current)
+  {
+    if (is_fair(band(_current->queue_prio())))
+      fair_charge(_current, now);
     //reinterpret_cast<Quant_sc *>(_current->__scs[0])->perf_deactivate();
-    _current->deactivate();
+    _current->deactivate(now);
+  }
   //reinterpret_cast<Quant_sc *>(scx->__scs[0])->perf_activate();
-  scx->activate();
+  scx->_vruntime_since = now;
+  scx->activate(now);
   activate(scx);
+  Sched_status::switched_sc(scx);
 
   LOG_SCHED_LOAD(scx);
 }
@@ -11,6 +11,7 @@ INTERFACE:
 #include "cxx/dlist"
 
 class Sched_context;
+class Ready_queue;
 
 class Sched_constraint
 : public cxx::Dyn_castable<Sched_constraint, Kobject>,
@@ -35,6 +36,28 @@ public:
   bool dying() const
   { return _dying; }
 
+  /// Time accounted to a constraint, in µs.
+  struct Stats
+  {
+    /// Time attached Sched_contexts ran.
+    Unsigned64 consumed;
+    /// Time attached Sched_contexts were ready but blocked by this constraint.
+    Unsigned64 blocked;
+    /// Time attached Sched_contexts were blocked by a bandwidth throttle.
+    Unsigned64 throttled;
+  };
+
+  /**
+   * Whether the constraint throttles memory bandwidth. Blocks by a
+   * throttle are also accounted as throttled time to the other
+   * constraints of the blocked Sched_context.
+   */
+  bool throttle() const
+  { return _throttle; }
+
+  void set_throttle(bool t)
+  { _throttle = t; }
+
   void block(Sched_context *scx);
   void deblock(Sched_context *scx);
 
@@ -43,6 +66,17 @@ public:
   virtual void migrate_away() = 0;
   virtual void migrate_to(Cpu_number) = 0;
 
+  /**
+   * Activity outside of a thread that is gated by a constraint, such as
+   * the delivery of an interrupt. It is deferred while the constraint does
+   * not allow running and released when it does again.
+   */
+  class Deferred : public cxx::D_list_item
+  {
+  public:
+    virtual void released() = 0;
+  };
+
   enum Type
   {
     Cond_sc,
@@ -50,6 +84,7 @@ public:
     Budget_sc,
     Timer_window_sc,
     Mbw_sc,
+    Group_sc,
   };
 
 private:
@@ -57,8 +92,12 @@ private:
   bool _run;
   typedef cxx::Sd_list<Sched_context> Blocked_list;
   Blocked_list _list;
+  typedef cxx::Sd_list<Deferred> Deferred_list;
+  Deferred_list _deferred;
   bool _dying;
   bool _wake_up_is_blocking;
+  bool _throttle;
+  Stats _stats;
 };
 
 class Cond_sc : public Sched_constraint
@@ -88,7 +127,18 @@ public:
   void inline replenish()
   { set_left(_quantum); }
 
+  unsigned weight() const override
+  { return _weight; }
+
 private:
+  enum Operation
+  {
+    Op_Set_weight,
+  };
+
+  /// Larger weights would let short runs not advance the virtual run time.
+  enum : Mword { Max_weight = 64 * 1024 };
+
   class Timeslice_timeout : public Timeout
   {
   public:
@@ -102,11 +152,15 @@ private:
 
   Unsigned64 _quantum;
   Unsigned64 _left;
+  /// Weight in fair-share bands, 0 for the default.
+  unsigned _weight;
   Timeslice_timeout _tt;
 };
 
 class Budget_sc : public Sched_constraint
 {
+  friend class Ready_queue_test;
+
 public:
   Unsigned64 get_budget() const
   { return _budget; }
@@ -191,6 +245,84 @@ private:
   Timer_window_sc_timeout _timeout;
 };
 
+/**
+ * A group of Sched_contexts that is scheduled as one entity.
+ *
+ * The group competes in the ready queue of its CPU at its own priority and
+ * occupies a single entry there. Its members are ordered by their own
+ * priorities in a local ready queue of the group. An optional budget
+ * limits the time all members together may run per period. An exhausted
+ * group leaves the ready queue with all its members at once.
+ *
+ * The group belongs to the CPU it was created on. Members that run on
+ * other CPUs compete there at the priority of the group and are only
+ * blocked while the group is exhausted, without being charged.
+ */
+class Group_sc : public cxx::Dyn_castable<Group_sc, Sched_constraint>
+{
+  friend class Ready_queue;
+
+public:
+  Unsigned8 prio() const
+  { return _prio; }
+
+  Ready_queue *rq() const
+  { return _rq; }
+
+  /// The member representing the group in the ready queue, if any.
+  Sched_context *head() const
+  { return _head; }
+
+private:
+  typedef cxx::Sd_list<Sched_context> Queue;
+
+  /// Number of priorities of the members, as in the ready queue.
+  enum { Priorities = 256 };
+
+  class Group_sc_timeout : public Timeout
+  {
+  public:
+    Group_sc_timeout(Group_sc *sc) : _sc(sc)
+    {}
+
+  protected:
+    Group_sc *_sc;
+  };
+
+  class Repl_timeout : public Group_sc_timeout
+  {
+  public:
+    Repl_timeout(Group_sc *sc) : Group_sc_timeout(sc)
+    {}
+
+  private:
+    bool expired() override;
+  };
+
+  class Oob_timeout : public Group_sc_timeout
+  {
+  public:
+    Oob_timeout(Group_sc *sc) : Group_sc_timeout(sc)
+    {}
+
+  private:
+    bool expired() override;
+  };
+
+  Unsigned8 _prio;
+  Unsigned8 _local_highest;
+  /// Budget per period, 0 if the group is not limited in time.
+  Unsigned64 _budget;
+  Unsigned64 _period;
+  Unsigned64 _left;
+  Unsigned64 _next_repl;
+  Ready_queue *_rq;
+  Sched_context *_head;
+  Oob_timeout _oob_timeout;
+  Repl_timeout _repl_timeout;
+  Queue _queue[Priorities];
+};
+
 // --------------------------------------------------------------------------
 INTERFACE [mbwp]:
 
@@ -220,6 +352,7 @@ IMPLEMENTATION:
 
 #include <cassert>
 #include <cstddef>
+#include "atomic.h"
 #include "cpu_lock.h"
 #include "std_macros.h"
 #include "config.h"
@@ -245,7 +378,9 @@ Sched_constraint::Sched_constraint(Ram_quota *q)
 : _quota(q),
   _run(false),
   _dying(false),
-  _wake_up_is_blocking(false)
+  _wake_up_is_blocking(false),
+  _throttle(false),
+  _stats{0, 0, 0}
 {
   //printf("SC[%p]: created\n", this);
 }
@@ -275,7 +410,9 @@ Sched_constraint::block(Sched_context *scx)
   assert(test());
 
   Ready_queue::rq.current().ready_dequeue(scx);
+  scx->account_block(Timer::system_clock());
   _list.push_back(scx);
+  scx->set_blocked_on(this);
 }
 
 PRIVATE
@@ -294,6 +431,63 @@ Sched_constraint::in_my_blocked_list(Sched_context *scx)
   return false;
 }
 
+/**
+ * Account the end of a block of `scx` by this constraint at time `now`.
+ *
+ * \pre The constraint is locked.
+ */
+PRIVATE
+void
+Sched_constraint::account_deblock(Sched_context *scx, Unsigned64 now)
+{
+  Unsigned64 t = scx->account_deblock(now);
+  if (!t)
+    return;
+
+  _stats.blocked += t;
+  if (_throttle)
+  {
+    _stats.throttled += t;
+    scx->account_throttled(this, t);
+  }
+}
+
+/**
+ * Charge run time of an attached Sched_context.
+ *
+ * Called on every switch away from the Sched_context, so the time is added
+ * atomically instead of under the lock of the constraint.
+ */
+PUBLIC inline NEEDS["atomic.h"]
+void
+Sched_constraint::account_consumed(Unsigned64 t)
+{ atomic_add_fetch(&_stats.consumed, t); }
+
+/**
+ * Charge time an attached Sched_context was blocked by a throttle.
+ *
+ * \pre The constraint is locked.
+ */
+PUBLIC inline
+void
+Sched_constraint::account_throttled(Unsigned64 t)
+{ _stats.throttled += t; }
+
+/**
+ * Get a consistent copy of the accounted times.
+ *
+ * The consumed time is added without the lock and thus read atomically.
+ */
+PUBLIC
+Sched_constraint::Stats
+Sched_constraint::stats()
+{
+  auto guard { lock_guard(this) };
+  Stats s = _stats;
+  s.consumed = atomic_load(&_stats.consumed);
+  return s;
+}
+
 IMPLEMENT
 void
 Sched_constraint::deblock(Sched_context *scx)
@@ -310,16 +504,128 @@ Sched_constraint::deblock(Sched_context *scx)
     if (scx == i)
     {
       _list.remove(scx);
+      scx->set_blocked_on(nullptr);
+      account_deblock(scx, Timer::system_clock());
       scx->context()->xcpu_state_change(~0UL, Thread_ready);
       return;
     }
   }
 }
 
+/**
+ * Admit a deferrable activity.
+ *
+ * \param d     Activity to defer if the constraint does not allow running.
+ * \param cost  Time in µs to charge for the activity.
+ *
+ * \retval true   The activity may proceed, `cost` was charged.
+ * \retval false  The activity was deferred, Deferred::released() is called
+ *                once the constraint allows running again.
+ */
+PUBLIC
+bool
+Sched_constraint::admit(Deferred *d, Unsigned64 cost)
+{
+  auto guard { lock_guard(this) };
+
+  if (can_run())
+  {
+    if (cost)
+      consume(cost);
+    return true;
+  }
+
+  if (!Deferred_list::in_list(d))
+    _deferred.push_back(d);
+
+  arm_release();
+  return false;
+}
+
+/**
+ * Withdraw a deferred activity.
+ *
+ * \return true if `d` was deferred.
+ */
+PUBLIC
+bool
+Sched_constraint::cancel(Deferred *d)
+{
+  auto guard { lock_guard(this) };
+
+  if (!Deferred_list::in_list(d))
+    return false;
+
+  _deferred.remove(d);
+  return true;
+}
+
+/**
+ * Charge time spent outside of an attached thread.
+ *
+ * \pre The constraint is locked.
+ */
+PUBLIC virtual
+void
+Sched_constraint::consume(Unsigned64)
+{}
+
+/**
+ * Absolute deadline of the attached Sched_contexts for EDF scheduling, in
+ * µs of the system clock, or 0 if the constraint does not define one.
+ */
+PUBLIC virtual
+Unsigned64
+Sched_constraint::deadline() const
+{ return 0; }
+
+/**
+ * Weight of the attached Sched_contexts for fair-share scheduling, or 0 if
+ * the constraint does not define one.
+ */
+PUBLIC virtual
+unsigned
+Sched_constraint::weight() const
+{ return 0; }
+
+/**
+ * Make sure that the constraint allows running again at some point
+ * without an attached thread running.
+ *
+ * \pre The constraint is locked.
+ */
+PUBLIC virtual
+void
+Sched_constraint::arm_release()
+{}
+
+PRIVATE
+void
+Sched_constraint::release_deferred()
+{
+  for (;;)
+  {
+    Deferred *d;
+    {
+      auto guard { lock_guard(this) };
+      if (!can_run() || _deferred.empty())
+        return;
+
+      d = _deferred.front();
+      _deferred.remove(d);
+    }
+
+    // may defer d again
+    d->released();
+  }
+}
+
 PROTECTED
 void
 Sched_constraint::wake_up_all_blocked()
 {
+  release_deferred();
+
   auto guard { lock_guard(this) };
 
   assert(test());
@@ -327,8 +633,10 @@ Sched_constraint::wake_up_all_blocked()
   // TOMO: we want to requeue all blocked threads on THEIR home cpus
   Sched_context *scx;
 
+  Unsigned64 now = Timer::system_clock();
   for (auto scx = _list.begin(); scx != _list.end(); ++scx)
   {
+    account_deblock(*scx, now);
     (*scx)->context()->xcpu_state_change(~0UL, Thread_ready);
   }
 
@@ -337,11 +645,13 @@ Sched_constraint::wake_up_all_blocked()
     for (auto scx = _list.begin(); scx != _list.end();)
     {
       if (!_wake_up_is_blocking) {
+        (*scx)->set_blocked_on(nullptr);
         scx = _list.erase(scx);
         continue;
       }
 
       if (0 /* TODO: check for IPI received and wake up done; maybe Thread_ready state or maybe to ambiguous?*/) {
+        (*scx)->set_blocked_on(nullptr);
         scx = _list.erase(scx);
       }
       else
@@ -409,11 +719,14 @@ sched_constraint_factory(Ram_quota *q, Space *, L4_msg_tag t, Utcb const *u,
       res = Quant_sc::create(q);
       break;
     case Sched_constraint::Type::Budget_sc:
-      res = Budget_sc::create(q);
+      res = Budget_sc::create(q, t, u, err);
       break;
     case Sched_constraint::Type::Timer_window_sc:
       res = Timer_window_sc::create(q, t, u);
       break;
+    case Sched_constraint::Type::Group_sc:
+      res = Group_sc::create(q, t, u, err);
+      break;
     //case Sched_constraint::Type::Mbw_sc:
     //  res = Mbw_sc::create(q, t, u);
     //  break;
@@ -544,9 +857,49 @@ Quant_sc::Quant_sc(Ram_quota *q)
 : Sched_constraint(q),
   _quantum(Config::Default_time_slice),
   _left(Config::Default_time_slice),
+  _weight(0),
   _tt(this)
 { set_run(true); }
 
+PUBLIC
+void
+Quant_sc::invoke(L4_obj_ref self, L4_fpage::Rights rights, Syscall_frame *f,
+                 Utcb *utcb) override
+{
+  (void)rights;
+
+  L4_msg_tag res(L4_msg_tag::Schedule);
+
+  if (EXPECT_TRUE(self.op() & L4_obj_ref::Ipc_send))
+  {
+    switch (utcb->values[0])
+    {
+      case Op_Set_weight: res = set_weight(f->tag(), utcb); break;
+      default:   res = commit_result(-L4_err::ENosys); break;
+    }
+  }
+
+  f->tag(res);
+}
+
+/**
+ * Set the weight of the attached threads in fair-share bands.
+ *
+ * The weight applies from the next time a thread is charged or queued.
+ * The default weight is Sched_context::Default_weight.
+ */
+PRIVATE
+L4_msg_tag
+Quant_sc::set_weight(L4_msg_tag tag, Utcb const *utcb)
+{
+  if (tag.words() < 2 || utcb->values[1] == 0
+      || utcb->values[1] > Max_weight)
+    return commit_result(-L4_err::EInval);
+
+  _weight = utcb->values[1];
+  return commit_result(0);
+}
+
 IMPLEMENT
 bool
 Quant_sc::Timeslice_timeout::expired()
@@ -629,20 +982,49 @@ Budget_sc::operator delete (void *ptr)
   allocator()->q_free<Ram_quota>(sc->get_quota(), sc);
 }
 
+/**
+ * Create a budget constraint from a factory message.
+ *
+ * Budget and period are optional.  Without them, both default to the
+ * default time slice.  An empty budget or one larger than the period is
+ * rejected.
+ */
 PUBLIC static
 Budget_sc *
-Budget_sc::create(Ram_quota *q)
+Budget_sc::create(Ram_quota *q, L4_msg_tag t, Utcb const *u, int *err)
 {
-  void *p = allocator()->q_alloc<Ram_quota>(q);
-  return p ? new (p) Budget_sc(q) : 0;
+  Unsigned64 budget = Config::Default_time_slice;
+  Unsigned64 period = Config::Default_time_slice;
+
+  if (t.words() >= 7)
+  {
+    budget = u->values[4];
+    period = u->values[6];
+  }
+
+  if (budget == 0 || budget > period)
+  {
+    *err = L4_err::EInval;
+    return 0;
+  }
+
+  return create(q, budget, period);
+}
+
+PUBLIC static
+Budget_sc *
+Budget_sc::create(Ram_quota *q, Unsigned64 b, Unsigned64 p)
+{
+  void *m = allocator()->q_alloc<Ram_quota>(q);
+  return m ? new (m) Budget_sc(q, b, p) : 0;
 }
 
 PUBLIC
-Budget_sc::Budget_sc(Ram_quota *q)
+Budget_sc::Budget_sc(Ram_quota *q, Unsigned64 b, Unsigned64 p)
 : Sched_constraint(q),
-  _budget(Config::Default_time_slice),
-  _period(Config::Default_time_slice),
-  _left(Config::Default_time_slice),
+  _budget(b),
+  _period(p),
+  _left(b),
   _oob_timeout(this),
   _next_repl(0),
   _repl_timeout(this)
@@ -731,6 +1113,57 @@ Budget_sc::period_expired()
   return true;
 }
 
+/**
+ * Charge `cost` µs to the budget.
+ *
+ * If an attached thread runs on another CPU, its accounting overwrites
+ * the budget when it is descheduled, so nothing is charged then.
+ */
+PUBLIC
+void
+Budget_sc::consume(Unsigned64 cost) override
+{
+  Context *curr { ::current() };
+  bool active = curr && curr->sched() && curr->sched()->contains(this);
+
+  if (active)
+    deactivate();
+  else if (_oob_timeout.is_set())
+    return;
+
+  set_left(_left > cost ? _left - cost : 0);
+  if (!_left)
+  {
+    set_run(false);
+    arm_release();
+  }
+
+  if (active)
+    activate();
+}
+
+/**
+ * The end of the current period.
+ */
+PUBLIC
+Unsigned64
+Budget_sc::deadline() const override
+{ return _next_repl; }
+
+PUBLIC
+void
+Budget_sc::arm_release() override
+{
+  if (_repl_timeout.is_set())
+    return;
+
+  // No attached thread ran since the last replenishment.
+  if (Timer::system_clock() >= _next_repl)
+    calc_and_schedule_next_repl(current_cpu());
+  else
+    _repl_timeout.set(_next_repl, current_cpu());
+}
+
 PUBLIC
 void
 Budget_sc::deactivate() override
@@ -943,6 +1376,244 @@ void
 Timer_window_sc::migrate_to(Cpu_number) override
 {}
 
+static Kmem_slab_t<Group_sc> _group_sc_allocator("Group_sc");
+
+PRIVATE static
+Group_sc::Self_alloc *
+Group_sc::allocator()
+{ return _group_sc_allocator.slab(); }
+
+PUBLIC inline
+void
+Group_sc::operator delete (void *ptr)
+{
+  Group_sc *sc = reinterpret_cast<Group_sc *>(ptr);
+  allocator()->q_free<Ram_quota>(sc->get_quota(), sc);
+}
+
+/**
+ * Create a group constraint from a factory message.
+ *
+ * The message holds the priority of the group and, optionally, a budget
+ * and a period. Without them, the group is not limited in time. A priority
+ * out of range, an empty budget or one larger than the period is rejected.
+ */
+PUBLIC static
+Group_sc *
+Group_sc::create(Ram_quota *q, L4_msg_tag t, Utcb const *u, int *err)
+{
+  if (t.words() < 5 || u->values[4] >= Priorities)
+  {
+    *err = L4_err::EInval;
+    return 0;
+  }
+
+  Unsigned8 prio = u->values[4];
+  Unsigned64 budget = 0;
+  Unsigned64 period = 0;
+
+  if (t.words() >= 9)
+  {
+    budget = u->values[6];
+    period = u->values[8];
+
+    if (budget == 0 || budget > period)
+    {
+      *err = L4_err::EInval;
+      return 0;
+    }
+  }
+
+  void *m = allocator()->q_alloc<Ram_quota>(q);
+  return m ? new (m) Group_sc(q, prio, budget, period) : 0;
+}
+
+PUBLIC
+Group_sc::Group_sc(Ram_quota *q, Unsigned8 prio, Unsigned64 b, Unsigned64 p)
+: Dyn_castable_class(q),
+  _prio(prio),
+  _local_highest(0),
+  _budget(b),
+  _period(p),
+  _left(b),
+  _next_repl(0),
+  _rq(&Ready_queue::rq.current()),
+  _head(nullptr),
+  _oob_timeout(this),
+  _repl_timeout(this)
+{
+  set_run(true);
+
+  if (_budget)
+  {
+    _next_repl = Timer::system_clock() + _period;
+    _repl_timeout.set(_next_repl, current_cpu());
+  }
+}
+
+PUBLIC
+Group_sc::~Group_sc()
+{
+  assert(!_head);
+  _oob_timeout.reset();
+  _repl_timeout.reset();
+}
+
+PRIVATE inline
+void
+Group_sc::set_head(Sched_context *scx)
+{ _head = scx; }
+
+/**
+ * The most important member in the local ready queue, if any.
+ */
+PRIVATE inline
+Sched_context *
+Group_sc::local_next() const
+{ return _queue[_local_highest].front(); }
+
+PRIVATE
+void
+Group_sc::local_enqueue(Sched_context *scx, bool front)
+{
+  Unsigned8 prio = scx->prio();
+
+  if (prio > _local_highest)
+    _local_highest = prio;
+
+  _queue[prio].push(scx, front ? Queue::Front : Queue::Back);
+}
+
+PRIVATE
+void
+Group_sc::local_dequeue(Sched_context *scx)
+{
+  _queue[scx->prio()].remove(scx);
+
+  while (_queue[_local_highest].empty() && _local_highest)
+    _local_highest--;
+}
+
+PRIVATE inline
+void
+Group_sc::local_requeue(Sched_context *scx)
+{ _queue[scx->prio()].rotate_to(*++Queue::iter(scx)); }
+
+/**
+ * Whether the budget of the group is tracked on the current CPU.
+ */
+PRIVATE inline
+bool
+Group_sc::accounted_here() const
+{ return _budget && _rq == &Ready_queue::rq.current(); }
+
+IMPLEMENT
+bool
+Group_sc::Oob_timeout::expired()
+{
+  if (M_TIMER_DEBUG) printf("TIMER> GSC[%p]: budget timeout expired\n", _sc);
+  _sc->exhausted();
+  // force reschedule
+  return true;
+}
+
+IMPLEMENT
+bool
+Group_sc::Repl_timeout::expired()
+{
+  if (M_TIMER_DEBUG) printf("TIMER> GSC[%p]: replenishment timeout expired\n", _sc);
+  return _sc->period_expired();
+}
+
+PRIVATE
+void
+Group_sc::exhausted()
+{
+  if (M_SCHEDULER_DEBUG) printf("SCHEDULER> GSC[%p]: exhausted\n", this);
+  set_left(0);
+  set_run(false);
+  _rq->group_suspend(this);
+}
+
+PRIVATE
+bool
+Group_sc::period_expired()
+{
+  if (M_SCHEDULER_DEBUG) printf("SCHEDULER> GSC[%p]: period_expired\n", this);
+  Unsigned64 now = Timer::system_clock();
+  do
+    _next_repl += _period;
+  while (_next_repl <= now);
+  _repl_timeout.set(_next_repl, current_cpu());
+
+  set_left(_budget);
+  set_run(true);
+  _rq->group_resume(this);
+
+  // members on other CPUs
+  wake_up_all_blocked();
+
+  Context *curr { ::current() };
+
+  if (curr && curr->sched()->contains(this))
+  {
+    _oob_timeout.reset();
+    activate();
+  }
+
+  // reschedule, if the group can preempt the current thread.
+  return true;
+}
+
+PUBLIC inline
+void
+Group_sc::set_left(Unsigned64 l)
+{ _left = l; }
+
+/**
+ * The end of the current period, if the group has a budget.
+ */
+PUBLIC
+Unsigned64
+Group_sc::deadline() const override
+{ return _budget ? _next_repl : 0; }
+
+PUBLIC
+void
+Group_sc::deactivate() override
+{
+  if (!accounted_here() || !_oob_timeout.is_set())
+    return;
+
+  Unsigned64 clock = Timer::system_clock();
+  Signed64 left = _oob_timeout.get_timeout(clock);
+
+  set_left(max(left, static_cast<Signed64>(0)));
+  _oob_timeout.reset();
+}
+
+PUBLIC
+void
+Group_sc::activate() override
+{
+  if (!accounted_here() || !can_run())
+    return;
+
+  Unsigned64 clock = Timer::system_clock();
+  if (M_TIMER_DEBUG) printf("TIMER> GSC[%p]: setting budget timeout @ %llu\n", this, clock + _left);
+  _oob_timeout.set(clock + _left, current_cpu());
+}
+
+PUBLIC
+void
+Group_sc::migrate_away() override
+{ deactivate(); }
+
+PUBLIC
+void
+Group_sc::migrate_to(Cpu_number) override
+{}
+
 // --------------------------------------------------------------------------
 IMPLEMENTATION [mbwp]:
 
@@ -991,6 +1662,7 @@ Mbw_sc::Mbw_sc(Ram_quota *q, Unsigned64 r, Unsigned64 w)
 {
   _budget[0] = Mbwp::mbs_to_cache_events(r);
   _budget[1] = Mbwp::mbs_to_cache_events(w);
+  set_throttle(true);
   set_run(true);
 }
 
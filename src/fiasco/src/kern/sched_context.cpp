@@ -10,6 +10,8 @@ INTERFACE:
 #include <cxx/dlist>
 
 class Sched_constraint;
+class Group_sc;
+class Ready_queue;
 
 class Sched_context : public cxx::D_list_item
 {
@@ -18,6 +20,7 @@ class Sched_context : public cxx::D_list_item
   friend class Jdb_thread_list;
   friend class Sched_ctxts_test;
   friend class Scheduler_test;
+  friend class Ready_queue_test;
   friend class Ready_queue;
   friend class Context;
 
@@ -45,7 +48,37 @@ public:
 private:
   Unsigned8 _prio;
   //Spin_lock<> _lock;
+
+  /// Start of the current constraint block, or 0 if not blocked.
+  Unsigned64 _blocked_since = 0;
+  /// Accumulated time spent runnable but blocked by a constraint.
+  Unsigned64 _blocked_time = 0;
+  /// Time this Sched_context became the current one on its CPU.
+  Unsigned64 _switched_in = 0;
+  /// Group constraint this Sched_context is scheduled in, if any.
+  Group_sc *_group = nullptr;
+  /// Constraint whose blocked list holds this Sched_context, if any.
+  Sched_constraint *_blocked_on = nullptr;
+
+  enum : unsigned { Heap_none = ~0U };
+  /// Position in the heap of the ready queue, or Heap_none.
+  unsigned _heap_pos = Heap_none;
+  /// Key this Sched_context is ordered by in the heap: the deadline in EDF
+  /// bands, the virtual run time in fair-share bands.
+  Unsigned64 _key = ~0ULL;
+  /// Run time scaled by the inverse weight, for fair-share bands.
+  Unsigned64 _vruntime = 0;
+  /// Start of the run not yet charged to _vruntime.
+  Unsigned64 _vruntime_since = 0;
+  /// Ready queue whose virtual time _vruntime refers to, or nullptr if
+  /// _vruntime is an offset carried over from another CPU.
+  Ready_queue const *_vruntime_rq = nullptr;
+  /// Band generation of that ready queue _vruntime refers to.
+  Mword _vruntime_gen = 0;
 public:
+  /// Weight of a Sched_context without a weighted constraint.
+  enum : unsigned { Default_weight = 1024 };
+
   Sched_constraint *__scs[Config::Scx_max_sc] = { nullptr };
   typedef cxx::static_vector<Sched_constraint *, unsigned> Sc_list;
   Sc_list _list;
@@ -59,6 +92,8 @@ IMPLEMENTATION:
 #include "std_macros.h"
 #include "config.h"
 #include "lock_guard.h"
+#include "context.h"
+#include "ready_queue.h"
 #include "sched_constraint.h"
 
 #include <cassert>
@@ -130,13 +165,50 @@ PUBLIC inline
 bool
 Sched_context::is_queued() const
 {
-  return cxx::Sd_list<Sched_context>::in_list(this);
+  return cxx::Sd_list<Sched_context>::in_list(this) || _heap_pos != Heap_none;
 }
 
 PUBLIC inline
+Group_sc *
+Sched_context::group() const
+{ return _group; }
+
+/**
+ * Priority at which this Sched_context competes in the per-CPU ready queue.
+ *
+ * This is the priority of its group, if it is scheduled in one, or its own
+ * priority otherwise.
+ */
+PUBLIC inline NEEDS["sched_constraint.h"]
+unsigned short
+Sched_context::queue_prio() const
+{ return _group ? _group->prio() : _prio; }
+
+/**
+ * Check if this Sched_context preempts `sc`.
+ *
+ * Members of the same group are compared by their own priorities. Two
+ * Sched_contexts in the same EDF or fair-share band are compared by the key
+ * of the heap of the ready queue, all others by the priority they compete
+ * at in the ready queue.
+ */
+PUBLIC
 bool
 Sched_context::dominates(Sched_context *sc) const
-{ return prio() > sc->prio(); }
+{
+  if (_group && _group == sc->_group)
+    return prio() > sc->prio();
+
+  unsigned b = Ready_queue::band(queue_prio());
+  if (b == Ready_queue::band(sc->queue_prio()))
+    {
+      Ready_queue const &rq = Ready_queue::rq.cpu(context()->home_cpu());
+      if (rq.in_heap(b))
+        return rq.peek_key(this) < rq.peek_key(sc);
+    }
+
+  return queue_prio() > sc->queue_prio();
+}
 
 PUBLIC
 bool
@@ -172,6 +244,73 @@ Sched_context::is_constrained() const
 //  _blocked_by = nullptr;
 //}
 
+/**
+ * Constraint whose blocked list holds this Sched_context, if any.
+ *
+ * A blocked Sched_context is linked into that list instead of a ready
+ * queue, so is_queued() is true for it as well.
+ */
+PUBLIC inline
+Sched_constraint *
+Sched_context::blocked_on() const
+{ return _blocked_on; }
+
+PUBLIC inline
+void
+Sched_context::set_blocked_on(Sched_constraint *sc)
+{ _blocked_on = sc; }
+
+/**
+ * Note that a constraint blocked this Sched_context at time `now`.
+ *
+ * Blocks by further constraints while already blocked are not counted
+ * twice.
+ */
+PUBLIC inline
+void
+Sched_context::account_block(Unsigned64 now)
+{
+  if (!_blocked_since)
+    _blocked_since = now;
+}
+
+/**
+ * Note that the blocking constraint released this Sched_context at time
+ * `now`.
+ *
+ * \return Duration of the block that ended.
+ */
+PUBLIC inline
+Unsigned64
+Sched_context::account_deblock(Unsigned64 now)
+{
+  if (!_blocked_since)
+    return 0;
+
+  Unsigned64 t = now > _blocked_since ? now - _blocked_since : 0;
+  _blocked_time += t;
+  _blocked_since = 0;
+  return t;
+}
+
+/**
+ * Time this Sched_context was ready to run but blocked by one of its
+ * constraints, including a block still in progress at `now`.
+ *
+ * The value is read without synchronization and may lag behind for
+ * Sched_contexts on remote CPUs.
+ */
+PUBLIC inline
+Unsigned64
+Sched_context::blocked_time(Unsigned64 now) const
+{
+  Unsigned64 since = access_once(&_blocked_since);
+  Unsigned64 t = access_once(&_blocked_time);
+  if (since && now > since)
+    t += now - since;
+  return t;
+}
+
 PUBLIC inline
 bool
 Sched_context::can_run()
@@ -205,22 +344,36 @@ Sched_context::check_sc_list()
   return true;
 }
 
+/**
+ * Stop running at time `now` and charge the time since activate() to all
+ * attached constraints.
+ *
+ * A second call without activate() in between, e.g. for a thread killed
+ * by do_kill() that is deactivated again on the switch away from it,
+ * charges nothing.
+ */
 PUBLIC
 void
-Sched_context::deactivate() const
+Sched_context::deactivate(Unsigned64 now)
 {
+  Unsigned64 ran = now > _switched_in ? now - _switched_in : 0;
+  _switched_in = now;
   for (Sched_constraint *sc : _list)
   {
-    if (sc)
-      sc->deactivate();
-      //reinterpret_cast<Quant_sc *>(sc)->perf_deactivate();
+    if (!sc)
+      continue;
+
+    sc->deactivate();
+    //reinterpret_cast<Quant_sc *>(sc)->perf_deactivate();
+    sc->account_consumed(ran);
   }
 }
 
 PUBLIC
 void
-Sched_context::activate() const
+Sched_context::activate(Unsigned64 now)
 {
+  _switched_in = now;
   for (Sched_constraint *sc : _list)
   {
     if (sc)
@@ -229,6 +382,27 @@ Sched_context::activate() const
   }
 }
 
+/**
+ * Charge the duration `t` of a block by the throttle `by` to all other
+ * attached constraints.
+ *
+ * \pre `by` is locked. Throttles are always locked before the other
+ *      constraints, so other throttles are skipped.
+ */
+PUBLIC
+void
+Sched_context::account_throttled(Sched_constraint const *by, Unsigned64 t) const
+{
+  for (Sched_constraint *sc : _list)
+  {
+    if (!sc || sc == by || sc->throttle())
+      continue;
+
+    auto guard { lock_guard(sc) };
+    sc->account_throttled(t);
+  }
+}
+
 PUBLIC
 void
 Sched_context::migrate_away() const
@@ -251,6 +425,78 @@ Sched_context::migrate_to(Cpu_number cpu) const
   }
 }
 
+/**
+ * Absolute deadline for EDF scheduling.
+ *
+ * \return The earliest deadline of all attached constraints, or ~0 if none
+ *         has one.
+ */
+PUBLIC
+Unsigned64
+Sched_context::edf_deadline() const
+{
+  Unsigned64 dl = ~0ULL;
+  for (Sched_constraint *sc : _list)
+  {
+    if (!sc)
+      continue;
+
+    Unsigned64 d = sc->deadline();
+    if (d && d < dl)
+      dl = d;
+  }
+
+  return dl;
+}
+
+/**
+ * Weight for fair-share scheduling.
+ *
+ * \return The largest weight of all attached constraints, or
+ *         Default_weight if none has one.
+ */
+PUBLIC
+unsigned
+Sched_context::weight() const
+{
+  unsigned w = 0;
+  for (Sched_constraint *sc : _list)
+  {
+    if (sc && sc->weight() > w)
+      w = sc->weight();
+  }
+
+  return w ? w : static_cast<unsigned>(Default_weight);
+}
+
+/**
+ * Virtual run time including the time since the last charge until `now`.
+ */
+PUBLIC
+Unsigned64
+Sched_context::vruntime_at(Unsigned64 now) const
+{
+  if (now <= _vruntime_since)
+    return _vruntime;
+
+  return _vruntime + (now - _vruntime_since) * Default_weight / weight();
+}
+
+/**
+ * Charge the time since the last charge at `now` to the virtual run time.
+ *
+ * \return The virtual run time before the charge.
+ */
+PUBLIC
+Unsigned64
+Sched_context::charge_vruntime(Unsigned64 now)
+{
+  Unsigned64 vr = _vruntime;
+  _vruntime = vruntime_at(now);
+  _vruntime_since = now;
+  return vr;
+}
+
 PUBLIC
 bool
 Sched_context::contains(Sched_constraint *sc) const
@@ -276,15 +522,35 @@ Sched_context::print() const
   //printf(">\n");
 }
 
+/**
+ * Attach constraint `sc`.
+ *
+ * \retval 0               Success.
+ * \retval -L4_err::EExists `sc` is already attached, or `sc` is a Group_sc
+ *                         and this Sched_context is already in a group.
+ * \retval -L4_err::EInval `sc` is a Group_sc and the home CPU of the
+ *                         context is not the current CPU.
+ * \retval -L4_err::ENomem All constraint slots are in use.
+ */
 PUBLIC
-bool
+int
 Sched_context::attach(Sched_constraint *sc)
 {
   assert(sc);
 
   //auto lg { lock_guard(_lock) };
 
-  assert(!contains(sc));
+  if (contains(sc))
+    return -L4_err::EExists;
+
+  Group_sc *g = cxx::dyn_cast<Group_sc *>(sc);
+  if (g && _group)
+    return -L4_err::EExists;
+
+  // set_group() changes the ready queue of the home CPU, which only that
+  // CPU may do
+  if (g && context()->home_cpu() != current_cpu())
+    return -L4_err::EInval;
 
   for (Sched_constraint *&i : _list)
   {
@@ -293,10 +559,12 @@ Sched_context::attach(Sched_constraint *sc)
 
     i = sc;
     sc->inc_ref();
-    return true;
+    if (g)
+      set_group(g);
+    return 0;
   }
 
-  return false;
+  return -L4_err::ENomem;
 }
 
 PUBLIC
@@ -316,6 +584,9 @@ Sched_context::detach(Sched_constraint *sc)
 
     i = nullptr;
 
+    if (sc == _group)
+      set_group(nullptr);
+
     auto guard { lock_guard(sc) };
 
     sc->deblock(this);
@@ -339,6 +610,30 @@ Sched_context::detach(Sched_constraint *sc)
   return false;
 }
 
+/**
+ * Move this Sched_context into or out of a group.
+ *
+ * A Sched_context in the ready queue of its home CPU, or in the local
+ * queue of its group, is taken out and put back, so that it ends up in the
+ * right queue. A Sched_context blocked by a constraint stays in the blocked
+ * list and is queued according to the new group when it is deblocked.
+ */
+PRIVATE
+void
+Sched_context::set_group(Group_sc *g)
+{
+  Ready_queue &rq = Ready_queue::rq.cpu(context()->home_cpu());
+  bool do_rq = is_queued() && !_blocked_on;
+
+  if (do_rq)
+    rq.ready_dequeue(this);
+
+  _group = g;
+
+  if (do_rq && is_constrained())
+    rq.ready_enqueue(this);
+}
+
 PUBLIC
 void
 Sched_context::detach_all()
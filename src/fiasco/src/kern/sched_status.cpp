@@ -0,0 +1,199 @@
+/*
+ * Scheduler status page.
+ */
+
+// --------------------------------------------------------------------------
+INTERFACE:
+
+#include "config.h"
+#include "types.h"
+
+class Sched_context;
+
+/**
+ * Per-CPU scheduler state published in kernel memory that a privileged
+ * task maps read-only, see Scheduler::sys_map_status().
+ *
+ * There is one record per possible CPU, written only by its own CPU. A
+ * record is refreshed at every schedule() and context switch. Writers
+ * increment the sequence counter before and after an update, so readers
+ * retry while it is odd or if it changed during the read.
+ *
+ * The memory is allocated when it is mapped for the first time. Until
+ * then all updates are skipped.
+ */
+class Sched_status
+{
+public:
+  enum
+  {
+    Bands    = 8,
+    Rec_size = 128,
+  };
+
+  struct Rec
+  {
+    /// Sequence counter, odd while the record is updated.
+    Mword seq;
+    /// Debug ID of the thread of the current Sched_context.
+    Mword current;
+    /// Number of queued timeouts.
+    Mword timeouts;
+    /// The memory-bandwidth throttle blocks this CPU.
+    Mword mbwp_throttled;
+    /// Number of context switches.
+    Unsigned64 context_switches;
+    /// Number of schedule() calls.
+    Unsigned64 schedules;
+    /// Number of ready Sched_contexts per priority band.
+    Mword ready[Bands];
+  } __attribute__((aligned(Rec_size)));
+
+  static_assert(sizeof(Rec) == Rec_size, "Sched_status record size");
+
+private:
+  static Rec *_recs;
+};
+
+// --------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include "atomic.h"
+#include "context.h"
+#include "cpu_lock.h"
+#include "kmem_alloc.h"
+#include "mbwp.h"
+#include "mem.h"
+#include "ready_queue.h"
+#include "thread.h"
+#include "timeout.h"
+
+#include <cassert>
+#include <cstring>
+
+Sched_status::Rec *Sched_status::_recs;
+
+/// Size of the status memory, a power of two and at least a page.
+PUBLIC static inline
+unsigned long
+Sched_status::size()
+{
+  unsigned long s = Config::PAGE_SIZE;
+  while (s < Config::Max_num_cpus * sizeof(Rec))
+    s <<= 1;
+  return s;
+}
+
+/**
+ * Get the status memory, allocate it if necessary.
+ *
+ * \return Kernel address of the status memory, or 0 if out of memory.
+ */
+PUBLIC static
+void *
+Sched_status::mem()
+{
+  if (Rec *r = access_once(&_recs))
+    return r;
+
+  void *p = Kmem_alloc::allocator()->alloc(Bytes(size()));
+  if (!p)
+    return 0;
+
+  memset(p, 0, size());
+  Mem::mp_wmb();
+  if (!mp_cas(&_recs, static_cast<Rec *>(0), static_cast<Rec *>(p)))
+    Kmem_alloc::allocator()->free(Bytes(size()), p);
+
+  return _recs;
+}
+
+/// Get the record of the current CPU.
+PRIVATE static inline NEEDS["cpu_lock.h", <cassert>]
+Sched_status::Rec *
+Sched_status::rec()
+{
+  assert(cpu_lock.test());
+  return _recs + cxx::int_value<Cpu_number>(current_cpu());
+}
+
+PRIVATE static inline NEEDS["mem.h"]
+void
+Sched_status::begin(Rec *r)
+{
+  write_now(&r->seq, r->seq + 1);
+  Mem::mp_wmb();
+}
+
+/// Refresh the snapshot part of `r` and end the update.
+PRIVATE static
+void
+Sched_status::end(Rec *r)
+{
+  Ready_queue const &rq = Ready_queue::rq.current();
+  for (unsigned b = 0; b < Bands; ++b)
+    r->ready[b] = rq.ready_in_band(b);
+
+  r->timeouts = Timeout_q::timeout_queue.current().depth();
+  r->mbwp_throttled = Mbwp::throttled();
+
+  Mem::mp_wmb();
+  write_now(&r->seq, r->seq + 1);
+}
+
+PRIVATE static
+void
+Sched_status::do_scheduled()
+{
+  Rec *r = rec();
+  begin(r);
+  ++r->schedules;
+  end(r);
+}
+
+PRIVATE static
+void
+Sched_status::do_context_switched()
+{
+  Rec *r = rec();
+  begin(r);
+  ++r->context_switches;
+  end(r);
+}
+
+PRIVATE static
+void
+Sched_status::do_switched_sc(Sched_context *scx)
+{
+  Rec *r = rec();
+  begin(r);
+  r->current = static_cast<Thread *>(scx->context())->dbg_id();
+  end(r);
+}
+
+/// Note a call of Context::schedule().
+PUBLIC static inline
+void
+Sched_status::scheduled()
+{
+  if (EXPECT_FALSE(access_once(&_recs) != 0))
+    do_scheduled();
+}
+
+/// Note a context switch.
+PUBLIC static inline
+void
+Sched_status::context_switched()
+{
+  if (EXPECT_FALSE(access_once(&_recs) != 0))
+    do_context_switched();
+}
+
+/// Note that `scx` became the current Sched_context.
+PUBLIC static inline
+void
+Sched_status::switched_sc(Sched_context *scx)
+{
+  if (EXPECT_FALSE(access_once(&_recs) != 0))
+    do_switched_sc(scx);
+}
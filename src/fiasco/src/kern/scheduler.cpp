@@ -20,8 +20,15 @@ public:
     Attach_sc     = 4,
     Detach_sc     = 5,
     Set_global_sc = 6,
+    Steal_time    = 7,
+    Sc_stats      = 8,
+    Map_status    = 9,
+    Set_band_policy = 10,
   };
 
+  /// Maximum number of constraints read by one Sc_stats call.
+  enum { Sc_stats_max = 256 };
+
   static Scheduler scheduler;
 private:
   Irq_base *_irq;
@@ -42,6 +49,13 @@ IMPLEMENTATION:
 #include "l4_types.h"
 #include "entry_frame.h"
 #include "mbwp.h"
+#include "minmax.h"
+#include "mem_layout.h"
+#include "ready_queue.h"
+#include "sched_constraint.h"
+#include "sched_status.h"
+#include "space.h"
+#include "timer.h"
 
 JDB_DEFINE_TYPENAME(Scheduler, "\033[34mSched\033[m");
 Scheduler Scheduler::scheduler;
@@ -190,8 +204,9 @@ Scheduler::sys_attach_sc(Syscall_frame *f, Utcb const *utcb)
   if (!sc)
     return tag;
 
-  if (!thread->sched()->attach(sc))
-    return commit_result(-L4_err::ENomem);
+  int err = thread->sched()->attach(sc);
+  if (err < 0)
+    return commit_result(err);
   thread->sched()->print();
 
   return commit_result(0);
@@ -222,6 +237,11 @@ Scheduler::sys_detach_sc(Syscall_frame *f, Utcb const *utcb)
   if (!sc)
     return tag;
 
+  // leaving a group changes the ready queue of the home CPU, see
+  // Sched_context::attach()
+  if (sc == thread->sched()->group() && thread->home_cpu() != current_cpu())
+    return commit_result(-L4_err::EInval);
+
   if (!thread->sched()->detach(sc))
     return commit_result(-L4_err::ENoent);
   //thread->sched()->detach_all();
@@ -247,6 +267,141 @@ Scheduler::sys_set_global_sc(Syscall_frame *f, Utcb const *utcb)
   return commit_result(0);
 }
 
+/**
+ * Return the time a thread was ready to run but blocked by one of its
+ * scheduling constraints.
+ */
+PRIVATE
+L4_msg_tag
+Scheduler::sys_steal_time(Syscall_frame *f, Utcb const *utcb, Utcb *out)
+{
+  L4_msg_tag tag { f->tag() };
+  Ko::Rights rights;
+
+  Thread *thread { Ko::deref<Thread>(&tag, utcb, &rights) };
+
+  if (!thread)
+    return tag;
+
+  reinterpret_cast<Utcb::Time_val *>(out->values)->t
+    = thread->sched()->blocked_time(Timer::system_clock());
+
+  return commit_result(0, Utcb::Time_val::Words);
+}
+
+/**
+ * Copy the accounted times of a range of scheduling constraints into
+ * kernel-user memory of the caller.
+ *
+ * The message holds the capability index of the first constraint, the
+ * number of consecutive capabilities, at most Sc_stats_max, and the
+ * address of the buffer. The record of a capability that does not refer
+ * to a constraint is filled with ~0. The label of the result is the
+ * number of records written.
+ */
+PRIVATE
+L4_msg_tag
+Scheduler::sys_sc_stats(Syscall_frame *f, Utcb const *utcb)
+{
+  typedef Sched_constraint::Stats Stats;
+
+  if (EXPECT_FALSE(f->tag().words() < 4))
+    return commit_result(-L4_err::EInval);
+
+  Space *const space = ::current()->space();
+  Mword const n = min<Mword>(utcb->values[2], Sc_stats_max);
+  User<Stats>::Ptr buf(reinterpret_cast<Stats *>(utcb->values[3]));
+
+  Space::Ku_mem const *m = space->find_ku_mem(buf, n * sizeof(Stats));
+  if (EXPECT_FALSE(!m))
+    return commit_result(-L4_err::EInval);
+
+  Stats *out = m->kern_addr(buf);
+  Cap_index const first = L4_obj_ref(utcb->values[1]).cap();
+  for (Mword i = 0; i < n; ++i)
+    {
+      Sched_constraint *sc
+        = cxx::dyn_cast<Sched_constraint *>(space->lookup_local(first + Cap_diff(i)));
+      if (sc)
+        out[i] = sc->stats();
+      else
+        out[i] = Stats{~0ULL, ~0ULL, ~0ULL};
+    }
+
+  return commit_result(n);
+}
+
+/**
+ * Map the scheduler status records of all CPUs read-only into the
+ * caller's address space.
+ *
+ * The message holds the page-aligned user address. The label of the
+ * result is the size of the mapped area.
+ *
+ * The area is kernel memory and thus not in the mapping database. It is
+ * mapped at most once per space, where it stays until the space is
+ * destroyed.
+ */
+PRIVATE
+L4_msg_tag
+Scheduler::sys_map_status(Syscall_frame *f, Utcb const *utcb)
+{
+  if (EXPECT_FALSE(f->tag().words() < 2))
+    return commit_result(-L4_err::EInval);
+
+  unsigned long const size = Sched_status::size();
+  Address const va = utcb->values[1];
+  if (EXPECT_FALSE((va & (Config::PAGE_SIZE - 1))
+                   || va > Mem_layout::User_max - size + 1))
+    return commit_result(-L4_err::EInval);
+
+  void *mem = Sched_status::mem();
+  if (EXPECT_FALSE(!mem))
+    return commit_result(-L4_err::ENomem);
+
+  Space *const space = ::current()->space();
+  if (EXPECT_FALSE(!space->claim_sched_status(va)))
+    return commit_result(-L4_err::EExists);
+
+  Mem_space::Page_order const po(Config::PAGE_SHIFT);
+  for (unsigned long o = 0; o < size; o += Config::PAGE_SIZE)
+    {
+      Mem_space::Phys_addr pa(space->pmem_to_phys((Address)mem + o));
+      Mem_space::Status res =
+        space->v_insert(pa, Virt_addr(va + o), po,
+                        Mem_space::Attr(L4_fpage::Rights::UR()));
+
+      if (EXPECT_TRUE(res == Mem_space::Insert_ok))
+        continue;
+
+      for (unsigned long u = 0; u < o; u += Config::PAGE_SIZE)
+        space->v_delete(Virt_addr(va + u), po, L4_fpage::Rights::FULL());
+
+      space->release_sched_status();
+      return commit_result(res == Mem_space::Insert_err_exists
+                           ? -L4_err::EExists : -L4_err::ENomem);
+    }
+
+  return commit_result(size);
+}
+
+/**
+ * Select fixed-priority, earliest-deadline-first or fair-share scheduling
+ * for a priority band of the CPU the caller runs on.
+ *
+ * The message holds the band and the Ready_queue::Band_policy.
+ */
+PRIVATE
+L4_msg_tag
+Scheduler::sys_set_band_policy(Syscall_frame *f, Utcb const *utcb)
+{
+  if (EXPECT_FALSE(f->tag().words() < 3))
+    return commit_result(-L4_err::EInval);
+
+  Ready_queue &rq = Ready_queue::rq.current();
+  return commit_result(rq.set_band_policy(utcb->values[1], utcb->values[2]));
+}
+
 PRIVATE
 L4_msg_tag
 Scheduler::op_sched_idle(L4_cpu_set const &cpus, Cpu_time *time)
@@ -373,6 +528,14 @@ Scheduler::kinvoke(L4_obj_ref ref, L4_fpage::Rights rights, Syscall_frame *f,
       return sys_detach_sc(f, iutcb);
     case Set_global_sc:
       return sys_set_global_sc(f, iutcb);
+    case Steal_time:
+      return sys_steal_time(f, iutcb, outcb);
+    case Sc_stats:
+      return sys_sc_stats(f, iutcb);
+    case Map_status:
+      return sys_map_status(f, iutcb);
+    case Set_band_policy:
+      return sys_set_band_policy(f, iutcb);
     default:
       return commit_result(-L4_err::ENosys);
     }
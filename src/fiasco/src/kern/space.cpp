@@ -105,6 +105,10 @@ protected:
 protected:
   typedef cxx::S_list<Ku_mem> Ku_mem_list;
   Ku_mem_list _ku_mem;
+
+private:
+  /// User address of the scheduler status area, ~0UL if not mapped.
+  Address _sched_status_va = ~0UL;
 };
 
 
@@ -127,6 +131,27 @@ PUBLIC inline Ram_quota * Space::ram_quota() const
 
 IMPLEMENT inline Space::~Space() {}
 
+/**
+ * Reserve user address `va` for the scheduler status area.
+ *
+ * The area is mapped at most once per space and stays mapped until the
+ * space is destroyed.
+ *
+ * \return false if the area is already mapped into this space.
+ */
+PUBLIC inline NEEDS["atomic.h"]
+bool
+Space::claim_sched_status(Address va)
+{ return mp_cas(&_sched_status_va, ~0UL, va); }
+
+/**
+ * Undo claim_sched_status() after the area could not be mapped.
+ */
+PUBLIC inline
+void
+Space::release_sched_status()
+{ write_now(&_sched_status_va, ~0UL); }
+
 PUBLIC
 Space::Ku_mem const *
 Space::find_ku_mem(User<void>::Ptr p, unsigned size)
@@ -192,6 +192,7 @@ IMPLEMENTATION:
 #include "task.h"
 #include "thread_state.h"
 #include "timeout.h"
+#include "timer.h"
 #include "sched_constraint.h"
 #include "ready_queue.h"
 
@@ -597,7 +598,7 @@ Thread::do_kill()
   // to the 'invalid' CPU forcefully and then switching to the kernel
   // thread for doing the last bits.
   force_to_invalid_cpu();
-  sched()->deactivate();
+  sched()->deactivate(Timer::system_clock());
   kernel_context_drq(handle_kill_helper, 0);
   kdb_ke("I'm dead");
   return true;
@@ -1342,6 +1343,8 @@ Thread::migrate_away(Migration *inf, bool remote)
           rq.set_current(kernel_context(current_cpu())->sched());
           resched = true;
         }
+
+      rq.fair_migrate_away(sched());
     }
 
   Cpu_number target_cpu = inf->cpu;
@@ -4,6 +4,8 @@ INTERFACE:
 #include "l4_types.h"
 #include "per_cpu_data.h"
 
+class Timeout_q;
+
 /** A timeout basic object. It contains the necessary queues and handles
     enqueuing, dequeuing and handling of timeouts. Real timeout classes
     should overwrite expired(), which will do the real work, if an
@@ -26,6 +28,12 @@ protected:
   Unsigned64 _wakeup;
 
 private:
+  /**
+   * Queue the timeout was last enqueued in. Resetting the timeout may
+   * happen on another CPU.
+   */
+  Timeout_q *_queue = nullptr;
+
   /**
    * Default copy constructor (is undefined).
    */
@@ -47,6 +55,7 @@ private:
 
 class Timeout_q
 {
+  friend class Timeout;
   friend class Timeouts_test;
 private:
   /**
@@ -73,14 +82,21 @@ private:
   Unsigned64 _current;
   Unsigned64 _old_clock;
 
+  /// Number of queued timeouts. Updated atomically, because a timeout may
+  /// be reset on another CPU.
+  Mword _depth = 0;
+
 public:
   static Per_cpu<Timeout_q> timeout_queue;
+
+  Mword depth() const { return access_once(&_depth); }
 };
 
 //----------------------------------------------------------------------------------
 IMPLEMENTATION:
 
 #include <cassert>
+#include "atomic.h"
 #include "cpu_lock.h"
 #include "kip.h"
 #include "lock_guard.h"
@@ -113,7 +129,7 @@ Timeout_q::queues() const { return Wakeup_queue_count; }
 /**
  * Enqueue a new timeout.
  */
-PUBLIC inline NEEDS[Timeout_q::first, "timer.h", "config.h"]
+PUBLIC inline NEEDS[Timeout_q::first, "timer.h", "config.h", "atomic.h"]
 void
 Timeout_q::enqueue(Timeout *to)
 {
@@ -126,6 +142,8 @@ Timeout_q::enqueue(Timeout *to)
     ++tmp;
 
   q.insert_before(to, tmp);
+  to->_queue = this;
+  atomic_mp_add(&_depth, 1);
 
   if (Config::Scheduler_one_shot && (to->_wakeup <= _current))
     {
@@ -250,12 +268,16 @@ Timeout::set_again(Cpu_number cpu)
  *
  * \pre `cpu_lock` must be held
  */
-PUBLIC inline NEEDS [<cassert>, "cpu_lock.h"]
+PUBLIC inline NEEDS [<cassert>, "atomic.h", "cpu_lock.h", Timeout::is_set]
 void
 Timeout::reset()
 {
   assert (cpu_lock.test());
+  if (!is_set())
+    return;
+
   To_list::remove(this);
+  atomic_mp_add(&_queue->_depth, Mword(-1));
 
   // Normaly we should reprogramm the timer in one shot mode
   // But we let the timer interrupt handler to do this "lazily", to save cycles
@@ -279,7 +301,7 @@ Timeout::expire()
  * @return true if a reschedule is necessary, false otherwise.
  */
 PUBLIC inline NEEDS [<cassert>, <climits>, "kip.h", "timer.h", "config.h",
-                     Timeout::expire, "mbwp.h"]
+                     Timeout::expire, "mbwp.h", "atomic.h"]
 bool
 Timeout_q::do_timeouts()
 {
@@ -327,6 +349,7 @@ Timeout_q::do_timeouts()
         {
           Timeout *to = *timeout;
           timeout = q.erase(timeout);
+          atomic_mp_add(&_depth, Mword(-1));
           reschedule |= to->expire();
         }
 
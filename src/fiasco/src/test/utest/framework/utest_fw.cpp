@@ -283,6 +283,7 @@ IMPLEMENTATION:
 #include <feature.h>
 #include "mem.h"
 #include "poll_timeout_kclock.h"
+#include "ready_queue.h"
 #include "timer_tick.h"
 
 /**
@@ -937,8 +938,8 @@ void
 Utest::kill_current_thread()
 {
   auto guard = lock_guard(cpu_lock);
-  Sched_context::rq.current().deblock(current()->sched(),
-                                      current()->sched());
+  Ready_queue::rq.current().deblock(current()->sched(),
+                                    current()->sched());
   Thread::do_leave_and_kill_myself();
 }
 
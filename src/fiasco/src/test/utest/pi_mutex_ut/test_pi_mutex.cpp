@@ -0,0 +1,328 @@
+/* SPDX-License-Identifier: GPL-2.0-only or License-Ref-kk-custom */
+
+/**
+ * Pi_mutex: acquisition of a free mutex, hand-off to the highest-priority
+ * waiter, and the priority boost of the owner.
+ *
+ * The lock word lives in kernel memory, and the threads never run. They only
+ * take the roles of owner and waiters, so the tests call the operations of
+ * the mutex on their behalf.
+ */
+
+INTERFACE:
+
+#include "pi_mutex.h"
+
+static char const __attribute__((unused)) *Pi_mutex_group = "Pi_mutex";
+
+class Thread_object;
+
+class Pi_mutex_test
+{
+};
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include "utest_fw.h"
+#include "cpu_lock.h"
+#include "l4_error.h"
+#include "lock_guard.h"
+#include "ram_quota.h"
+#include "ready_queue.h"
+#include "sched_constraint.h"
+#include "sched_context.h"
+#include "thread_object.h"
+#include "thread_state.h"
+
+void
+init_unittest()
+{
+  Utest_fw::tap_log.start();
+
+  Pi_mutex_test().test_uncontended();
+  Pi_mutex_test().test_handoff();
+  Pi_mutex_test().test_ceiling();
+  Pi_mutex_test().test_foreign_prio();
+  Pi_mutex_test().test_blocked_owner();
+
+  Utest_fw::tap_log.finish();
+}
+
+PUBLIC
+Pi_mutex_test::~Pi_mutex_test()
+{
+  Utest_fw::tap_log.test_done();
+}
+
+/**
+ * Create a thread with priority `prio` that is neither dead nor ready.
+ *
+ * The thread keeps an extra reference, so that the references the mutex
+ * drops never delete it.
+ */
+PRIVATE static
+Thread_object *
+Pi_mutex_test::create_thread(unsigned prio)
+{
+  Thread_object *t = new (Ram_quota::root) Thread_object(Ram_quota::root);
+  Utest_fw::chk(t, "Create thread");
+
+  t->inc_ref();
+  t->set_home_cpu(current_cpu());
+  t->state_change_dirty(~Thread_dead, 0);
+  t->change_prio_to(prio);
+  return t;
+}
+
+PRIVATE static
+Pi_mutex *
+Pi_mutex_test::create_mutex(Unsigned8 ceiling = 0)
+{
+  Pi_mutex *m = Pi_mutex::create(Ram_quota::root, nullptr,
+                                 User<Mword>::Ptr(), ceiling);
+  Utest_fw::chk(m, "Create mutex");
+  return m;
+}
+
+/// Run Pi_mutex::lock() for `t` on the lock word `w`.
+PRIVATE static
+int
+Pi_mutex_test::lock(Pi_mutex *m, Thread *t, Mword *w)
+{
+  Thread *put = 0;
+  int r = m->lock(t, w, &put);
+  Pi_mutex::put_owner(put);
+  return r;
+}
+
+/**
+ * Run Pi_mutex::unlock() for `t` on the lock word `w`.
+ *
+ * \return The result of unlock() and the new owner in `wakeup`.
+ */
+PRIVATE static
+int
+Pi_mutex_test::unlock(Pi_mutex *m, Thread *t, Mword *w, Thread **wakeup)
+{
+  Thread *put = 0;
+  *wakeup = 0;
+  int r = m->unlock(t, w, &put, wakeup);
+  Pi_mutex::put_owner(put);
+  return r;
+}
+
+/**
+ * A free mutex is acquired without blocking, and released without a
+ * hand-off if nobody waits. Only the owner may release it.
+ */
+PUBLIC
+void
+Pi_mutex_test::test_uncontended()
+{
+  Utest_fw::tap_log.new_test(Pi_mutex_group, __func__,
+                             "21fbe81e-a92f-4d6d-8293-ee8d826f8605");
+
+  auto guard = lock_guard(cpu_lock);
+
+  Thread_object *a = create_thread(10);
+  Thread_object *b = create_thread(20);
+  Pi_mutex *m = create_mutex();
+  Mword w = 0;
+  Thread *wakeup;
+
+  UTEST_EQ(Utest::Expect, lock(m, a, &w), 0, "Free mutex is acquired");
+  UTEST_EQ(Utest::Expect, w, Mword{Pi_mutex::Waiters},
+           "Lock word marks an owner known to the kernel");
+  UTEST_TRUE(Utest::Expect, m->_owner == a, "Owner is known to the kernel");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 10, "No boost without waiters");
+
+  UTEST_EQ(Utest::Expect, lock(m, a, &w), -L4_err::EBusy,
+           "Owner cannot acquire the mutex again");
+  UTEST_EQ(Utest::Expect, unlock(m, b, &w, &wakeup), -L4_err::EPerm,
+           "Only the owner releases the mutex");
+
+  UTEST_EQ(Utest::Expect, unlock(m, a, &w, &wakeup), 0, "Owner releases");
+  UTEST_EQ(Utest::Expect, w, Mword{0}, "Lock word is free");
+  UTEST_TRUE(Utest::Expect, m->_owner == nullptr, "No owner");
+  UTEST_TRUE(Utest::Expect, wakeup == nullptr, "Nobody to wake up");
+
+  delete m;
+}
+
+/**
+ * The owner runs at the priority of the highest-priority waiter. Unlock
+ * hands the mutex to that waiter and restores the priority of the old
+ * owner.
+ */
+PUBLIC
+void
+Pi_mutex_test::test_handoff()
+{
+  Utest_fw::tap_log.new_test(Pi_mutex_group, __func__,
+                             "edcc5b32-c24f-4959-a80a-d1d71e2dad87");
+
+  auto guard = lock_guard(cpu_lock);
+
+  Thread_object *a = create_thread(10);
+  Thread_object *b = create_thread(20);
+  Thread_object *c = create_thread(15);
+  Pi_mutex *m = create_mutex();
+  Mword w = 0;
+  Thread *wakeup;
+
+  UTEST_EQ(Utest::Assert, lock(m, a, &w), 0, "Low priority owner");
+  UTEST_EQ(Utest::Expect, lock(m, b, &w), 1, "High priority waiter blocks");
+  UTEST_TRUE(Utest::Expect, b->state() & Thread_receive_wait,
+             "Waiter waits for the hand-off");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 20,
+           "Owner boosted to the waiter");
+  UTEST_EQ(Utest::Expect, lock(m, c, &w), 1, "Medium priority waiter blocks");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 20,
+           "Owner keeps the highest waiter priority");
+
+  UTEST_EQ(Utest::Expect, unlock(m, a, &w, &wakeup), 0, "Owner releases");
+  UTEST_TRUE(Utest::Expect, wakeup == b, "Highest priority waiter wakes up");
+  UTEST_TRUE(Utest::Expect, m->_owner == b, "Mutex handed to the waiter");
+  UTEST_EQ(Utest::Expect, w, Mword{Pi_mutex::Waiters},
+           "Lock word marks an owner known to the kernel");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 10,
+           "Old owner back at its own priority");
+  UTEST_EQ(Utest::Expect, b->sched()->prio(), 20,
+           "No boost by a lower priority waiter");
+
+  UTEST_EQ(Utest::Expect, unlock(m, b, &w, &wakeup), 0, "New owner releases");
+  UTEST_TRUE(Utest::Expect, wakeup == c, "Last waiter wakes up");
+
+  UTEST_EQ(Utest::Expect, unlock(m, c, &w, &wakeup), 0, "Last owner releases");
+  UTEST_EQ(Utest::Expect, w, Mword{0}, "Lock word is free");
+  UTEST_TRUE(Utest::Expect, wakeup == nullptr, "Nobody to wake up");
+
+  delete m;
+}
+
+/**
+ * While there are waiters, the owner runs at least at the ceiling priority.
+ */
+PUBLIC
+void
+Pi_mutex_test::test_ceiling()
+{
+  Utest_fw::tap_log.new_test(Pi_mutex_group, __func__,
+                             "eaa29b08-655e-4fb8-b0e2-552b666595d8");
+
+  auto guard = lock_guard(cpu_lock);
+
+  Thread_object *a = create_thread(10);
+  Thread_object *b = create_thread(20);
+  Pi_mutex *m = create_mutex(30);
+  Mword w = 0;
+  Thread *wakeup;
+
+  UTEST_EQ(Utest::Assert, lock(m, a, &w), 0, "Owner acquires");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 10, "No boost without waiters");
+  UTEST_EQ(Utest::Expect, lock(m, b, &w), 1, "Waiter blocks");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 30,
+           "Owner boosted to the ceiling");
+
+  UTEST_EQ(Utest::Expect, unlock(m, a, &w, &wakeup), 0, "Owner releases");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 10,
+           "Old owner back at its own priority");
+  UTEST_EQ(Utest::Expect, b->sched()->prio(), 20,
+           "No ceiling boost without waiters");
+
+  UTEST_EQ(Utest::Expect, unlock(m, b, &w, &wakeup), 0, "New owner releases");
+
+  delete m;
+}
+
+/**
+ * A priority change of the owner by someone else while it is boosted
+ * becomes its new base priority and is kept on unlock.
+ */
+PUBLIC
+void
+Pi_mutex_test::test_foreign_prio()
+{
+  Utest_fw::tap_log.new_test(Pi_mutex_group, __func__,
+                             "b4548f1d-cec3-4798-9853-0ea65fc8c448");
+
+  auto guard = lock_guard(cpu_lock);
+
+  Thread_object *a = create_thread(10);
+  Thread_object *b = create_thread(20);
+  Pi_mutex *m = create_mutex();
+  Mword w = 0;
+  Thread *wakeup;
+
+  UTEST_EQ(Utest::Assert, lock(m, a, &w), 0, "Owner acquires");
+  UTEST_EQ(Utest::Expect, lock(m, b, &w), 1, "Waiter blocks");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 20, "Owner boosted");
+
+  a->change_prio_to(25);
+
+  UTEST_EQ(Utest::Expect, unlock(m, a, &w, &wakeup), 0, "Owner releases");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 25,
+           "Foreign priority change kept");
+
+  UTEST_EQ(Utest::Expect, unlock(m, b, &w, &wakeup), 0, "New owner releases");
+
+  delete m;
+}
+
+/**
+ * Boosting an owner that is blocked by one of its constraints changes its
+ * priority but leaves it in the blocked list of the constraint.
+ */
+PUBLIC
+void
+Pi_mutex_test::test_blocked_owner()
+{
+  Utest_fw::tap_log.new_test(Pi_mutex_group, __func__,
+                             "3779f2fd-baa4-42c4-8083-c978a7402aba");
+
+  auto guard = lock_guard(cpu_lock);
+
+  Thread_object *a = create_thread(10);
+  Thread_object *b = create_thread(20);
+  Pi_mutex *m = create_mutex();
+  Cond_sc *sc = Cond_sc::create(Ram_quota::root);
+  Utest_fw::chk(sc, "Create constraint");
+  Mword w = 0;
+  Thread *wakeup;
+
+  UTEST_EQ(Utest::Assert, lock(m, a, &w), 0, "Owner acquires");
+
+    {
+      auto g = lock_guard(sc);
+      sc->block(a->sched());
+    }
+
+  UTEST_EQ(Utest::Expect, lock(m, b, &w), 1, "Waiter blocks");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 20, "Blocked owner boosted");
+  UTEST_TRUE(Utest::Expect, a->sched()->blocked_on() == sc,
+             "Owner still blocked by the constraint");
+
+  UTEST_EQ(Utest::Expect, unlock(m, a, &w, &wakeup), 0, "Owner releases");
+  UTEST_EQ(Utest::Expect, a->sched()->prio(), 10,
+           "Old owner back at its own priority");
+  UTEST_TRUE(Utest::Expect, a->sched()->blocked_on() == sc,
+             "Old owner still blocked by the constraint");
+
+    {
+      auto g = lock_guard(sc);
+      sc->deblock(a->sched());
+    }
+
+  UTEST_TRUE(Utest::Expect, a->sched()->blocked_on() == nullptr,
+             "Owner found in the blocked list of the constraint");
+
+  // deblock() made the owner ready, but it must never run
+  Ready_queue::rq.current().ready_dequeue(a->sched());
+  a->state_change_dirty(~Thread_ready, 0);
+
+  UTEST_EQ(Utest::Expect, unlock(m, b, &w, &wakeup), 0, "New owner releases");
+
+  delete m;
+  delete sc;
+}
@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: GPL-2.0-only or License-Ref-kk-custom */
+
+INTERFACE:
+
+#include "ready_queue.h"
+#include "sched_context.h"
+#include "types.h"
+#include "utest_fw.h"
+
+class Budget_sc;
+
+static char const __attribute__((unused)) *Ready_queue_group = "Ready_queue";
+
+/**
+ * Base of the ready queue tests.
+ *
+ * The tests work on a ready queue of their own and on Sched_contexts that do
+ * not belong to a thread, so the scheduling of the CPU is not affected.
+ */
+class Ready_queue_test
+{
+public:
+  enum : unsigned
+  {
+    /// Priority band configured by the tests.
+    Band = 2,
+    /// Lowest priority of Band.
+    Band_prio = Band * (Ready_queue::priorities / Ready_queue::bands),
+    /// Enough Sched_contexts to overflow the heap.
+    Num_scx = Ready_queue::heap_max + 2,
+  };
+
+protected:
+  cxx::unique_ptr<Ready_queue, Utest::Deleter<Ready_queue>> rq;
+
+  static Sched_context scx[Num_scx];
+};
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include <cassert>
+#include <cstdio>
+#include "sched_constraint.h"
+
+Sched_context Ready_queue_test::scx[Ready_queue_test::Num_scx];
+
+inline
+void
+utest_format_print_value(Sched_context *val) { printf("%p", val); }
+
+PUBLIC
+Ready_queue_test::Ready_queue_test()
+: rq(Utest::kmem_create_clear<Ready_queue>())
+{
+  Utest_fw::chk(rq.get(), "Allocate ready queue");
+}
+
+PUBLIC
+Ready_queue_test::~Ready_queue_test()
+{
+  Utest_fw::tap_log.test_done();
+}
+
+/// Set the priority of `s`, which must not be ready.
+PROTECTED static
+void
+Ready_queue_test::set_prio(Sched_context *s, unsigned prio)
+{
+  assert(!s->is_queued());
+  s->_prio = prio;
+}
+
+/// Whether `s` is ready in the heap of `rq` instead of a priority queue.
+PROTECTED static
+bool
+Ready_queue_test::in_heap(Sched_context const *s)
+{ return s->_heap_pos != Sched_context::Heap_none; }
+
+PROTECTED
+unsigned
+Ready_queue_test::heap_cnt() const
+{ return rq->_heap_cnt; }
+
+/// Make `deadline` the deadline `b` passes on to its Sched_contexts.
+PROTECTED static
+void
+Ready_queue_test::set_deadline(Budget_sc *b, Unsigned64 deadline)
+{ b->_next_repl = deadline; }
+
+/// Set the virtual time of fair-share band `b` of `q`.
+PROTECTED static
+void
+Ready_queue_test::set_fair_clock(Ready_queue *q, unsigned b, Unsigned64 t)
+{ q->_fair_clock[b] = t; }
+
+PROTECTED static
+Unsigned64
+Ready_queue_test::fair_clock(Ready_queue const *q, unsigned b)
+{ return q->_fair_clock[b]; }
+
+PROTECTED static
+Mword
+Ready_queue_test::fair_gen(Ready_queue const *q, unsigned b)
+{ return q->_fair_gen[b]; }
+
+/**
+ * Give `s` the virtual run time `vr` of generation `gen` of ready queue `q`,
+ * or the offset `vr` carried over from another CPU if `q` is nullptr.
+ */
+PROTECTED static
+void
+Ready_queue_test::set_vruntime(Sched_context *s, Unsigned64 vr,
+                               Ready_queue const *q, Mword gen)
+{
+  s->_vruntime = vr;
+  s->_vruntime_rq = q;
+  s->_vruntime_gen = gen;
+}
+
+PROTECTED static
+Unsigned64
+Ready_queue_test::vruntime(Sched_context const *s)
+{ return s->_vruntime; }
+
+PROTECTED static
+Ready_queue const *
+Ready_queue_test::vruntime_rq(Sched_context const *s)
+{ return s->_vruntime_rq; }
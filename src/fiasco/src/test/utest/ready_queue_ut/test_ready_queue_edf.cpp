@@ -0,0 +1,203 @@
+/* SPDX-License-Identifier: GPL-2.0-only or License-Ref-kk-custom */
+
+/**
+ * Earliest-deadline-first bands of the ready queue: ordering by the deadline
+ * of the attached Budget_sc, and the overflow of a full heap into the
+ * fixed-priority queue of the band.
+ */
+
+INTERFACE:
+
+#include "common_test_ready_queue.h"
+
+class Ready_queue_edf_test : public Ready_queue_test
+{};
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include "cpu_lock.h"
+#include "lock_guard.h"
+#include "l4_error.h"
+#include "ram_quota.h"
+#include "sched_constraint.h"
+
+void
+init_unittest()
+{
+  Utest_fw::tap_log.start();
+
+  Ready_queue_edf_test().test_band_policy();
+  Ready_queue_edf_test().test_deadline_order();
+  Ready_queue_edf_test().test_heap_overflow();
+
+  Utest_fw::tap_log.finish();
+}
+
+/**
+ * A band can only change its policy while no Sched_context is ready in it.
+ */
+PUBLIC
+void
+Ready_queue_edf_test::test_band_policy()
+{
+  Utest_fw::tap_log.new_test(Ready_queue_group, __func__,
+                             "22007b2d-407d-443d-8c0f-d4f1b02fea63");
+
+  auto guard = lock_guard(cpu_lock);
+
+  UTEST_EQ(Utest::Expect, rq->set_band_policy(0, Ready_queue::Edf),
+           -L4_err::EInval, "Idle band stays fixed-priority");
+  UTEST_EQ(Utest::Expect,
+           rq->set_band_policy(Ready_queue::bands, Ready_queue::Edf),
+           -L4_err::EInval, "Band out of range");
+  UTEST_EQ(Utest::Expect, rq->set_band_policy(Band, Ready_queue::Fair + 1),
+           -L4_err::EInval, "Unknown policy");
+
+  UTEST_EQ(Utest::Assert, rq->set_band_policy(Band, Ready_queue::Edf), 0,
+           "Make band EDF");
+  UTEST_TRUE(Utest::Expect, rq->is_edf(Band), "Band is EDF");
+  UTEST_FALSE(Utest::Expect, rq->is_edf(Band + 1), "Next band is not EDF");
+
+  set_prio(&scx[0], Band_prio);
+  rq->enqueue(&scx[0], false);
+  UTEST_EQ(Utest::Expect,
+           rq->set_band_policy(Band, Ready_queue::Fixed_prio),
+           -L4_err::EBusy, "No policy change with a ready Sched_context");
+  UTEST_EQ(Utest::Expect, rq->set_band_policy(Band, Ready_queue::Edf), 0,
+           "Setting the same policy again succeeds");
+
+  rq->dequeue(&scx[0]);
+  UTEST_EQ(Utest::Expect,
+           rq->set_band_policy(Band, Ready_queue::Fixed_prio), 0,
+           "Policy change of an empty band");
+  UTEST_FALSE(Utest::Expect, rq->is_edf(Band), "Band is fixed-priority");
+}
+
+/**
+ * Sched_contexts in an EDF band run in the order of their deadlines. The
+ * band as a whole is ordered among the other bands by priority.
+ */
+PUBLIC
+void
+Ready_queue_edf_test::test_deadline_order()
+{
+  Utest_fw::tap_log.new_test(Ready_queue_group, __func__,
+                             "1c304d21-4f31-468e-aa2d-7e088358f073");
+
+  auto guard = lock_guard(cpu_lock);
+
+  UTEST_EQ(Utest::Assert, rq->set_band_policy(Band, Ready_queue::Edf), 0,
+           "Make band EDF");
+
+  static Unsigned64 const deadlines[] = { 3000, 1000, 2000 };
+  enum { N = sizeof(deadlines) / sizeof(deadlines[0]) };
+  Budget_sc *b[N];
+
+  for (unsigned i = 0; i < N; ++i)
+    {
+      b[i] = Budget_sc::create(Ram_quota::root, 100, 1000);
+      Utest_fw::chk(b[i], "Create Budget_sc");
+      set_deadline(b[i], deadlines[i]);
+      set_prio(&scx[i], Band_prio + i);
+      Utest_fw::chk(scx[i].attach(b[i]) == 0, "Attach Budget_sc");
+    }
+
+  UTEST_EQ(Utest::Expect, rq->peek_key(&scx[1]), 1000ULL,
+           "Key is the deadline of the Budget_sc");
+  UTEST_EQ(Utest::Expect, rq->peek_key(&scx[N]), ~0ULL,
+           "No deadline without a Budget_sc");
+
+  for (unsigned i = 0; i < N; ++i)
+    rq->enqueue(&scx[i], false);
+
+  UTEST_EQ(Utest::Expect, rq->ready_in_band(Band), Mword{N},
+           "All ready in band");
+  UTEST_EQ(Utest::Expect, rq->next_to_run(), &scx[1],
+           "Earliest deadline first, regardless of the priority");
+
+  // lower bands wait, higher bands preempt
+  set_prio(&scx[N], Band_prio - 1);
+  rq->enqueue(&scx[N], false);
+  UTEST_EQ(Utest::Expect, rq->next_to_run(), &scx[1],
+           "Lower fixed-priority band does not preempt");
+  rq->dequeue(&scx[N]);
+
+  set_prio(&scx[N], Band_prio + Ready_queue::priorities / Ready_queue::bands);
+  rq->enqueue(&scx[N], false);
+  UTEST_EQ(Utest::Expect, rq->next_to_run(), &scx[N],
+           "Higher fixed-priority band preempts");
+  rq->dequeue(&scx[N]);
+
+  rq->dequeue(&scx[1]);
+  UTEST_EQ(Utest::Expect, rq->next_to_run(), &scx[2],
+           "Next deadline after dequeue");
+
+  // a new period moves the deadline, requeue picks it up
+  set_deadline(b[2], 4000);
+  rq->requeue(&scx[2]);
+  UTEST_EQ(Utest::Expect, rq->next_to_run(), &scx[0],
+           "Requeue orders by the new deadline");
+
+  rq->dequeue(&scx[0]);
+  rq->dequeue(&scx[2]);
+  UTEST_EQ(Utest::Expect, rq->ready_in_band(Band), 0UL, "Band is empty");
+  UTEST_EQ(Utest::Expect, heap_cnt(), 0U, "Heap is empty");
+
+  for (unsigned i = 0; i < N; ++i)
+    {
+      scx[i].detach(b[i]);
+      delete b[i];
+    }
+}
+
+/**
+ * Sched_contexts beyond the capacity of the heap wait in the priority queue
+ * of their band behind all Sched_contexts in the heap, and move to the heap
+ * when it has room.
+ */
+PUBLIC
+void
+Ready_queue_edf_test::test_heap_overflow()
+{
+  Utest_fw::tap_log.new_test(Ready_queue_group, __func__,
+                             "e1731e97-cf33-45bd-aaed-3518d4800ef6");
+
+  auto guard = lock_guard(cpu_lock);
+
+  UTEST_EQ(Utest::Assert, rq->set_band_policy(Band, Ready_queue::Edf), 0,
+           "Make band EDF");
+
+  for (unsigned i = 0; i < Num_scx; ++i)
+    {
+      set_prio(&scx[i], Band_prio);
+      rq->enqueue(&scx[i], false);
+    }
+
+  unsigned const max = Ready_queue::heap_max;
+  UTEST_EQ(Utest::Expect, rq->ready_in_band(Band), Mword{Num_scx},
+           "All ready in band");
+  UTEST_EQ(Utest::Expect, heap_cnt(), max, "Heap is full");
+  UTEST_TRUE(Utest::Expect, scx[max].is_queued(), "Overflow is ready");
+  UTEST_FALSE(Utest::Expect, in_heap(&scx[max]), "Overflow not in heap");
+  UTEST_TRUE(Utest::Expect, in_heap(rq->next_to_run()),
+             "Heap runs before the overflow");
+
+  rq->dequeue(&scx[0]);
+  UTEST_EQ(Utest::Expect, heap_cnt(), max - 1, "Room in heap");
+  rq->requeue(&scx[max]);
+  UTEST_TRUE(Utest::Expect, in_heap(&scx[max]),
+             "Requeue moves overflow into heap");
+  UTEST_EQ(Utest::Expect, heap_cnt(), max, "Heap is full again");
+
+  for (unsigned i = 1; i <= max; ++i)
+    rq->dequeue(&scx[i]);
+
+  UTEST_EQ(Utest::Expect, heap_cnt(), 0U, "Heap is empty");
+  UTEST_EQ(Utest::Expect, rq->next_to_run(), &scx[max + 1],
+           "Overflow runs once the heap is empty");
+
+  rq->dequeue(&scx[max + 1]);
+  UTEST_EQ(Utest::Expect, rq->ready_in_band(Band), 0UL, "Band is empty");
+  UTEST_TRUE(Utest::Expect, rq->next_to_run() == nullptr, "Nothing ready");
+}
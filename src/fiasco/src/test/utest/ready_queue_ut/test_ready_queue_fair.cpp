@@ -0,0 +1,212 @@
+/* SPDX-License-Identifier: GPL-2.0-only or License-Ref-kk-custom */
+
+/**
+ * Weighted fair-share bands of the ready queue: ordering by virtual run
+ * time, and its normalisation to the virtual time of the band across CPUs
+ * and policy changes.
+ */
+
+INTERFACE:
+
+#include "common_test_ready_queue.h"
+
+class Ready_queue_fair_test : public Ready_queue_test
+{};
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include "cpu_lock.h"
+#include "lock_guard.h"
+
+void
+init_unittest()
+{
+  Utest_fw::tap_log.start();
+
+  Ready_queue_fair_test().test_vruntime_order();
+  Ready_queue_fair_test().test_vruntime_normalise();
+  Ready_queue_fair_test().test_vruntime_migrate();
+  Ready_queue_fair_test().test_vruntime_policy_reset();
+
+  Utest_fw::tap_log.finish();
+}
+
+/**
+ * Sched_contexts in a fair-share band run in the order of their virtual run
+ * time.
+ */
+PUBLIC
+void
+Ready_queue_fair_test::test_vruntime_order()
+{
+  Utest_fw::tap_log.new_test(Ready_queue_group, __func__,
+                             "45e8bc6e-5fc3-4fb2-877a-05630b8710f1");
+
+  auto guard = lock_guard(cpu_lock);
+
+  UTEST_EQ(Utest::Assert, rq->set_band_policy(Band, Ready_queue::Fair), 0,
+           "Make band fair-share");
+  UTEST_TRUE(Utest::Expect, rq->is_fair(Band), "Band is fair-share");
+
+  Mword gen = fair_gen(rq.get(), Band);
+  static Unsigned64 const vr[] = { 300, 100, 200 };
+  enum { N = sizeof(vr) / sizeof(vr[0]) };
+
+  for (unsigned i = 0; i < N; ++i)
+    {
+      set_prio(&scx[i], Band_prio);
+      set_vruntime(&scx[i], vr[i], rq.get(), gen);
+      rq->enqueue(&scx[i], false);
+    }
+
+  UTEST_EQ(Utest::Expect, rq->next_to_run(), &scx[1],
+           "Smallest virtual run time first");
+  rq->dequeue(&scx[1]);
+  UTEST_EQ(Utest::Expect, rq->next_to_run(), &scx[2],
+           "Next virtual run time after dequeue");
+
+  rq->dequeue(&scx[0]);
+  rq->dequeue(&scx[2]);
+  UTEST_EQ(Utest::Expect, heap_cnt(), 0U, "Heap is empty");
+}
+
+/**
+ * The key of a Sched_context is its virtual run time, but never less than
+ * the virtual time of the band. A run time that refers to another ready
+ * queue or to an earlier generation of the band is dropped, an offset left
+ * by a migration is put on top of the virtual time of the band.
+ */
+PUBLIC
+void
+Ready_queue_fair_test::test_vruntime_normalise()
+{
+  Utest_fw::tap_log.new_test(Ready_queue_group, __func__,
+                             "9ca12227-84d0-49cc-9fd6-6501a215e39a");
+
+  auto guard = lock_guard(cpu_lock);
+
+  auto other = Utest::kmem_create_clear<Ready_queue>();
+  Utest_fw::chk(other.get(), "Allocate other ready queue");
+
+  UTEST_EQ(Utest::Assert, rq->set_band_policy(Band, Ready_queue::Fair), 0,
+           "Make band fair-share");
+  set_fair_clock(rq.get(), Band, 1000);
+  Mword gen = fair_gen(rq.get(), Band);
+
+  for (unsigned i = 0; i < 5; ++i)
+    set_prio(&scx[i], Band_prio);
+
+  set_vruntime(&scx[0], 50, nullptr, 0);
+  UTEST_EQ(Utest::Expect, rq->peek_key(&scx[0]), 1050ULL,
+           "Offset on top of the band time");
+
+  set_vruntime(&scx[1], 2000, rq.get(), gen);
+  UTEST_EQ(Utest::Expect, rq->peek_key(&scx[1]), 2000ULL,
+           "Run time ahead of the band time is kept");
+
+  set_vruntime(&scx[2], 10, rq.get(), gen);
+  UTEST_EQ(Utest::Expect, rq->peek_key(&scx[2]), 1000ULL,
+           "Run time behind the band time is moved up");
+
+  set_vruntime(&scx[3], 5000, other.get(), gen);
+  UTEST_EQ(Utest::Expect, rq->peek_key(&scx[3]), 1000ULL,
+           "Run time of another ready queue is dropped");
+
+  set_vruntime(&scx[4], 5000, rq.get(), gen - 1);
+  UTEST_EQ(Utest::Expect, rq->peek_key(&scx[4]), 1000ULL,
+           "Run time of an earlier generation is dropped");
+
+  // enqueue stores the normalised run time
+  rq->enqueue(&scx[0], false);
+  UTEST_EQ(Utest::Expect, vruntime(&scx[0]), 1050ULL,
+           "Enqueue stores the normalised run time");
+  UTEST_TRUE(Utest::Expect, vruntime_rq(&scx[0]) == rq.get(),
+             "Run time refers to the ready queue");
+  rq->dequeue(&scx[0]);
+}
+
+/**
+ * A Sched_context that leaves a CPU keeps its lead over the virtual time of
+ * the band, but not a lag behind it.
+ */
+PUBLIC
+void
+Ready_queue_fair_test::test_vruntime_migrate()
+{
+  Utest_fw::tap_log.new_test(Ready_queue_group, __func__,
+                             "30dce34d-f8e4-42e7-8e56-8794cab21fa5");
+
+  auto guard = lock_guard(cpu_lock);
+
+  auto other = Utest::kmem_create_clear<Ready_queue>();
+  Utest_fw::chk(other.get(), "Allocate other ready queue");
+
+  UTEST_EQ(Utest::Assert, rq->set_band_policy(Band, Ready_queue::Fair), 0,
+           "Make band fair-share");
+  UTEST_EQ(Utest::Assert, other->set_band_policy(Band, Ready_queue::Fair), 0,
+           "Make band of other ready queue fair-share");
+  set_fair_clock(rq.get(), Band, 1000);
+  set_fair_clock(other.get(), Band, 7000);
+  Mword gen = fair_gen(rq.get(), Band);
+
+  set_prio(&scx[0], Band_prio);
+  set_vruntime(&scx[0], 1500, rq.get(), gen);
+  rq->fair_migrate_away(&scx[0]);
+  UTEST_EQ(Utest::Expect, vruntime(&scx[0]), 500ULL,
+           "Migration leaves the lead as offset");
+  UTEST_TRUE(Utest::Expect, vruntime_rq(&scx[0]) == nullptr,
+             "Offset refers to no ready queue");
+  UTEST_EQ(Utest::Expect, other->peek_key(&scx[0]), 7500ULL,
+           "Offset on top of the band time of the new CPU");
+
+  other->enqueue(&scx[0], false);
+  UTEST_EQ(Utest::Expect, vruntime(&scx[0]), 7500ULL,
+           "Enqueue on the new CPU applies the offset");
+  UTEST_TRUE(Utest::Expect, vruntime_rq(&scx[0]) == other.get(),
+             "Run time refers to the new ready queue");
+  other->dequeue(&scx[0]);
+
+  set_prio(&scx[1], Band_prio);
+  set_vruntime(&scx[1], 200, rq.get(), gen);
+  rq->fair_migrate_away(&scx[1]);
+  UTEST_EQ(Utest::Expect, vruntime(&scx[1]), 0ULL,
+           "Lag behind the band time is not carried over");
+  UTEST_EQ(Utest::Expect, other->peek_key(&scx[1]), 7000ULL,
+           "Starts at the band time of the new CPU");
+}
+
+/**
+ * Changing the policy of a band resets its virtual time and drops the run
+ * times that refer to the old one.
+ */
+PUBLIC
+void
+Ready_queue_fair_test::test_vruntime_policy_reset()
+{
+  Utest_fw::tap_log.new_test(Ready_queue_group, __func__,
+                             "f8aeb561-0be4-4057-a8b5-6b2776dfb55d");
+
+  auto guard = lock_guard(cpu_lock);
+
+  UTEST_EQ(Utest::Assert, rq->set_band_policy(Band, Ready_queue::Fair), 0,
+           "Make band fair-share");
+  set_fair_clock(rq.get(), Band, 3000);
+  Mword gen = fair_gen(rq.get(), Band);
+
+  set_prio(&scx[0], Band_prio);
+  set_vruntime(&scx[0], 3500, rq.get(), gen);
+
+  UTEST_EQ(Utest::Assert,
+           rq->set_band_policy(Band, Ready_queue::Fixed_prio), 0,
+           "Make band fixed-priority");
+  UTEST_EQ(Utest::Assert, rq->set_band_policy(Band, Ready_queue::Fair), 0,
+           "Make band fair-share again");
+
+  UTEST_EQ(Utest::Expect, fair_clock(rq.get(), Band), 0ULL,
+           "Band time is reset");
+  UTEST_NE(Utest::Expect, fair_gen(rq.get(), Band), gen,
+           "Band generation advanced");
+  UTEST_EQ(Utest::Expect, rq->peek_key(&scx[0]), 0ULL,
+           "Run time of the old band time is dropped");
+}
@@ -739,6 +739,8 @@ Boot_modules_image_mode::decompress_mods(unsigned mod_count,
 
   printf("Uncompressing modules (modaddr = %p (%s)):\n", destbuf,
          fwd ? "forwards" : "backwards");
+
+  unsigned long long t = boot_cycles();
   if (!fwd)
     {
       // advance to last module end
@@ -767,6 +769,10 @@ Boot_modules_image_mode::decompress_mods(unsigned mod_count,
         }
     }
 
+  if (t)
+    printf("Uncompressed modules in %llu kcycles.\n",
+           (boot_cycles() - t) / 1000);
+
   // move kernel, sigma0 and roottask out of the way
   for (unsigned i = 0; i < mod_count; ++i)
     {
@@ -33,6 +33,7 @@ my $prog_cc       = $ENV{CC}            || "${cross_compile_prefix}gcc";
 my $prog_nm       = $ENV{NM}            || "${cross_compile_prefix}nm";
 my $prog_cp       = $ENV{PROG_CP}       || "cp";
 my $prog_gzip     = $ENV{PROG_GZIP}     || "gzip";
+my $prog_lz4      = $ENV{PROG_LZ4}      || "lz4";
 my $compress      = $ENV{OPT_COMPRESS}  || 0;
 my $strip         = $ENV{OPT_STRIP}     || 1;
 my $output_dir    = $ENV{OUTPUT_DIR}    || '.';
@@ -97,6 +98,18 @@ my %output_formatter = (
   end    => \&default_output_end,
 );
 
+sub is_lz4_file
+{
+  my $file = shift;
+
+  open(my $f, $file) || die "Cannot open '$file': $!";
+  my $buf;
+  read $f, $buf, 4;
+  close $f;
+
+  return length($buf) >= 4 && unpack("V", $buf) == 0x184d2204;
+}
+
 # build object files from the modules
 sub build_obj
 {
@@ -144,9 +157,18 @@ sub build_obj
   close M;
 
   if ($compress and
-      not L4::ModList::is_gzipped_file("$modname.obj"))
+      not L4::ModList::is_gzipped_file("$modname.obj") and
+      not is_lz4_file("$modname.obj"))
     {
-       system("$prog_gzip -9f $modname.obj && mv $modname.obj.gz $modname.obj");
+       if ($compress eq 'lz4')
+         {
+           system("$prog_lz4 -9 -q -f --content-size $modname.obj $modname.obj.lz4 && mv $modname.obj.lz4 $modname.obj");
+         }
+       else
+         {
+           system("$prog_gzip -9f $modname.obj && mv $modname.obj.gz $modname.obj");
+         }
+       die "Compressing $modname.obj failed" if $?;
        $d{size_compressed} = -s "$modname.obj";
     }
 
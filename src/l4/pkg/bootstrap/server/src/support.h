@@ -59,6 +59,27 @@ clear_bss()
   memset(crt0_stack_high, 0, _bss_end - crt0_stack_high);
 }
 
+/**
+ * Read a free-running cycle counter, used for timing reports.
+ *
+ * \return Counter value, or 0 if the architecture has no usable counter.
+ */
+static inline unsigned long long
+boot_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned lo, hi;
+  asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((unsigned long long)hi << 32) | lo;
+#elif defined(__aarch64__)
+  unsigned long long v;
+  asm volatile ("mrs %0, CNTVCT_EL0" : "=r"(v));
+  return v;
+#else
+  return 0;
+#endif
+}
+
 static inline unsigned long
 round_wordsize(unsigned long s)
 { return (s + sizeof(unsigned long) - 1) & ~(sizeof(unsigned long) - 1); }
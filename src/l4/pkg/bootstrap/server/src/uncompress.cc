@@ -21,7 +21,9 @@
 #include <l4/sys/consts.h>
 
 #include "startup.h"
+#include "support.h"
 #include "gunzip.h"
+#include "unlz4.h"
 #include "uncompress.h"
 
 static void const *filestart;
@@ -87,24 +89,62 @@ grub_read(unsigned char *buf, int len)
   return module_read(buf, len);
 }
 
+static void
+print_start(const char *name, void const *start, void *destbuf,
+            int size, int size_uncompressed)
+{
+  printf("  Uncompressing %s from %p to %p (%d to %d bytes, %+lld%%).\n",
+        name, start, destbuf, size, size_uncompressed,
+	100*(unsigned long long)size_uncompressed/size - 100);
+}
+
+static void
+print_time(const char *name, unsigned long long start, int size_uncompressed)
+{
+  if (!start)
+    return;
+
+  unsigned long long cycles = boot_cycles() - start;
+
+  printf("  Uncompressed %s in %llu kcycles (%llu bytes/kcycle).\n",
+         name, cycles / 1000,
+         cycles ? 1000 * (unsigned long long)size_uncompressed / cycles : 0);
+}
+
 void *
 decompress(const char *name, void const *start, void *destbuf,
            int size, int size_uncompressed)
 {
   int read_size;
+  unsigned long long t;
 
   if (!size_uncompressed)
     return NULL;
 
+  if (unlz4_test_header(start, size))
+    {
+      print_start(name, start, destbuf, size, size_uncompressed);
+      t = boot_cycles();
+      read_size = unlz4(start, size, destbuf, size_uncompressed);
+      if (read_size != size_uncompressed)
+        {
+          printf("Incorrect decompression: should be %d bytes but got %d bytes.\n",
+                 size_uncompressed, read_size);
+          return NULL;
+        }
+
+      print_time(name, t, size_uncompressed);
+      return destbuf;
+    }
+
   file_open(start, size);
 
   // don't move data around if the data isn't compressed
   if (!compressed_file)
     return (void*)start;
 
-  printf("  Uncompressing %s from %p to %p (%d to %d bytes, %+lld%%).\n",
-        name, start, destbuf, size, size_uncompressed,
-	100*(unsigned long long)size_uncompressed/size - 100);
+  print_start(name, start, destbuf, size, size_uncompressed);
+  t = boot_cycles();
 
   // Add 10 to detect too short given size
   if ((read_size = grub_read((unsigned char*)destbuf, size_uncompressed + 10))
@@ -115,5 +155,6 @@ decompress(const char *name, void const *start, void *destbuf,
       return NULL;
     }
 
+  print_time(name, t, size_uncompressed);
   return destbuf;
 }
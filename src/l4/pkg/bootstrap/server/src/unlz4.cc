@@ -0,0 +1,232 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+/*
+ * Decompressor for the LZ4 frame format, as written by `lz4`.
+ *
+ * In contrast to gzip, LZ4 needs no tables and no separate window: the data
+ * is decoded directly into the destination buffer with plain copies, which
+ * makes it several times faster than inflate.
+ *
+ * Checksums are not verified, use BOOTSTRAP_CHECK_MD5 for that.
+ */
+
+#include <string.h>
+
+#include "unlz4.h"
+
+enum
+{
+  Lz4_magic           = 0x184d2204,
+  Lz4_skippable_magic = 0x184d2a50, // 0x184d2a50 - 0x184d2a5f
+
+  Flg_version_mask    = 0xc0,
+  Flg_version         = 0x40,
+  Flg_block_checksum  = 0x10,
+  Flg_content_size    = 0x08,
+  Flg_content_checksum= 0x04,
+  Flg_dict_id         = 0x01,
+
+  Block_uncompressed  = 0x80000000,
+  Min_match           = 4,
+};
+
+static inline unsigned
+get_le32(unsigned char const *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+bool
+unlz4_test_header(void const *start, unsigned long size)
+{
+  return size >= 4 && get_le32((unsigned char const *)start) == Lz4_magic;
+}
+
+/**
+ * Read an LZ4 length extension: bytes are added as long as they are 255.
+ *
+ * \return false if the input ends early.
+ */
+static inline bool
+read_length(unsigned char const **ip, unsigned char const *iend,
+            unsigned long *len)
+{
+  unsigned char b;
+  do
+    {
+      if (*ip >= iend)
+        return false;
+      b = *(*ip)++;
+      *len += b;
+    }
+  while (b == 255);
+
+  return true;
+}
+
+/**
+ * Decode one compressed block.
+ *
+ * \param ip      Start of the block.
+ * \param iend    End of the block.
+ * \param dst     Start of the destination buffer, i.e. the window.
+ * \param op      Current output position.
+ * \param oend    End of the destination buffer.
+ *
+ * \return New output position, or 0 on error.
+ */
+static unsigned char *
+decode_block(unsigned char const *ip, unsigned char const *iend,
+             unsigned char *dst, unsigned char *op, unsigned char *oend)
+{
+  while (ip < iend)
+    {
+      unsigned token = *ip++;
+
+      unsigned long lit = token >> 4;
+      if (lit == 15 && !read_length(&ip, iend, &lit))
+        return 0;
+
+      if (lit > (unsigned long)(iend - ip)
+          || lit > (unsigned long)(oend - op))
+        return 0;
+
+      memcpy(op, ip, lit);
+      ip += lit;
+      op += lit;
+
+      // the last sequence consists of literals only
+      if (ip == iend)
+        break;
+
+      if (iend - ip < 2)
+        return 0;
+
+      unsigned long offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (!offset || offset > (unsigned long)(op - dst))
+        return 0;
+
+      unsigned long len = token & 15;
+      if (len == 15 && !read_length(&ip, iend, &len))
+        return 0;
+      len += Min_match;
+
+      if (len > (unsigned long)(oend - op))
+        return 0;
+
+      unsigned char const *match = op - offset;
+      if (offset >= len)
+        {
+          memcpy(op, match, len);
+          op += len;
+        }
+      else
+        {
+          // overlapping match, repeats the last `offset` bytes
+          unsigned char *mend = op + len;
+          while (op < mend)
+            *op++ = *match++;
+        }
+    }
+
+  return op;
+}
+
+/**
+ * Decode one frame.
+ *
+ * \return End of the frame in the input, or 0 on error.
+ */
+static unsigned char const *
+decode_frame(unsigned char const *ip, unsigned char const *iend,
+             unsigned char *dst, unsigned char **op, unsigned char *oend)
+{
+  if (iend - ip < 7)
+    return 0;
+
+  unsigned flg = ip[4];
+  if ((flg & Flg_version_mask) != Flg_version)
+    return 0;
+
+  // magic, FLG, BD, optional content size and dictionary ID, HC
+  unsigned long hdr = 7;
+  if (flg & Flg_content_size)
+    hdr += 8;
+  if (flg & Flg_dict_id)
+    return 0; // we have no dictionaries
+
+  if ((unsigned long)(iend - ip) < hdr)
+    return 0;
+  ip += hdr;
+
+  for (;;)
+    {
+      if (iend - ip < 4)
+        return 0;
+
+      unsigned bsize = get_le32(ip);
+      ip += 4;
+      if (!bsize)
+        break; // end mark
+
+      unsigned long len = bsize & ~Block_uncompressed;
+      if (len > (unsigned long)(iend - ip))
+        return 0;
+
+      if (bsize & Block_uncompressed)
+        {
+          if (len > (unsigned long)(oend - *op))
+            return 0;
+          memcpy(*op, ip, len);
+          *op += len;
+        }
+      else if (!(*op = decode_block(ip, ip + len, dst, *op, oend)))
+        return 0;
+
+      ip += len;
+      if (flg & Flg_block_checksum)
+        ip += 4;
+    }
+
+  if (flg & Flg_content_checksum)
+    ip += 4;
+
+  return ip <= iend ? ip : 0;
+}
+
+long
+unlz4(void const *src, unsigned long size, void *dst, unsigned long dst_size)
+{
+  unsigned char const *ip = (unsigned char const *)src;
+  unsigned char const *iend = ip + size;
+  unsigned char *d = (unsigned char *)dst;
+  unsigned char *op = d;
+
+  // a file may consist of several concatenated frames
+  while (iend - ip >= 4)
+    {
+      unsigned magic = get_le32(ip);
+      if ((magic & 0xfffffff0) == Lz4_skippable_magic)
+        {
+          if (iend - ip < 8)
+            return -1;
+          unsigned long len = get_le32(ip + 4);
+          if (len > (unsigned long)(iend - ip - 8))
+            return -1;
+          ip += 8 + len;
+          continue;
+        }
+
+      if (magic != Lz4_magic)
+        break; // trailing padding
+
+      if (!(ip = decode_frame(ip, iend, d, &op, d + dst_size)))
+        return -1;
+    }
+
+  return op - d;
+}
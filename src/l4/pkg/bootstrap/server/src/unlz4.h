@@ -0,0 +1,28 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+/**
+ * Check whether the data at `start` begins with an LZ4 frame.
+ */
+bool unlz4_test_header(void const *start, unsigned long size);
+
+/**
+ * Decompress LZ4 frames.
+ *
+ * \param src       Compressed data, one or more LZ4 frames.
+ * \param size      Size of the compressed data.
+ * \param dst       Destination buffer.
+ * \param dst_size  Size of the destination buffer.
+ *
+ * \return Number of decompressed bytes, or -1 if the data is corrupt or does
+ *         not fit into the destination buffer.
+ *
+ * The destination buffer is used as window, so blocks may reference data of
+ * previous blocks.
+ */
+long unlz4(void const *src, unsigned long size, void *dst,
+           unsigned long dst_size);
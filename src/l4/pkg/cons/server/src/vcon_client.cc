@@ -8,13 +8,92 @@
  */
 #include "vcon_client.h"
 
+#include <l4/re/env>
+#include <l4/re/env.h>
+#include <l4/re/error_helper>
+#include <l4/sys/kip.h>
 #include <l4/sys/typeinfo_svr>
 
+#include <utility>
+
 unsigned Vcon_client::_dfl_obufsz = Vcon_client::Default_obuf_size;
 
+Vcon_client::~Vcon_client()
+{
+  for (auto const &l : _logs)
+    _registry->unregister_obj(l.get());
+}
+
+void
+Vcon_client::drain_log(Log_session *l)
+{
+  l->ring.drain([this](char const *d, unsigned long n)
+                { cooked_write(d, n); },
+                l4_kip_clock(l4re_kip()));
+}
+
 void
 Vcon_client::vcon_write(const char *buf, unsigned size) throw()
-{ cooked_write(buf, size); }
+{
+  // Clients fall back to IPC when their log ring is full, keep the order.
+  for (auto const &l : _logs)
+    drain_log(l.get());
+
+  cooked_write(buf, size);
+}
+
+/**
+ * Hand out a new log ring for this client.
+ *
+ * Every request gets its own ring, so a writer that stalls or corrupts its
+ * ring only delays its own output. The rings live as long as the client;
+ * beyond #Max_log_rings requests fail and the callers keep using IPC.
+ */
+int
+Vcon_client::vcon_log_ring(L4::Cap<void> *ds, L4::Cap<L4::Irq> *irq) throw()
+{
+  if (_logs.size() >= Max_log_rings)
+    return -L4_ENOMEM;
+
+  try
+    {
+      using L4Re::chkcap;
+      using L4Re::chksys;
+
+      auto *e = L4Re::Env::env();
+      unsigned long sz
+        = l4_round_page(L4Re::Util::Log_ring::mem_size(Log_ring_slots));
+
+      // Registered doorbells must not get lost in a failing push_back().
+      _logs.reserve(Max_log_rings);
+      std::unique_ptr<Log_session> l(new Log_session(this));
+      l->ds = chkcap(L4Re::Util::make_unique_cap<L4Re::Dataspace>(),
+                     "Allocate log ring capability");
+      chksys(e->mem_alloc()->alloc(sz, l->ds.get()), "Allocate log ring");
+      chksys(e->rm()->attach(&l->mem, sz,
+                             L4Re::Rm::F::Search_addr | L4Re::Rm::F::RW,
+                             L4::Ipc::make_cap_rw(l->ds.get())),
+             "Attach log ring");
+      l->ring.init(l->mem.get(), Log_ring_slots);
+
+      chkcap(_registry->register_irq_obj(l.get()),
+             "Register log ring doorbell");
+
+      *ds = l->ds.get();
+      *irq = L4::cap_cast<L4::Irq>(l->obj_cap());
+      _logs.push_back(std::move(l));
+    }
+  catch (L4::Runtime_error const &e)
+    {
+      return e.err_no();
+    }
+  catch (std::bad_alloc const &)
+    {
+      return -L4_ENOMEM;
+    }
+
+  return 0;
+}
 
 unsigned
 Vcon_client::vcon_read(char *buf, unsigned size) throw()
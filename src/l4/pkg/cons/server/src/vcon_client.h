@@ -13,8 +13,15 @@
 #include "server.h"
 
 #include <l4/re/util/icu_svr>
+#include <l4/re/util/log_ring>
 #include <l4/re/util/vcon_svr>
 #include <l4/re/util/object_registry>
+#include <l4/re/util/unique_cap>
+#include <l4/re/dataspace>
+#include <l4/re/rm>
+
+#include <memory>
+#include <vector>
 
 class Vcon_client
 : public L4::Epiface_t<Vcon_client, L4::Vcon, Server_object>,
@@ -27,16 +34,20 @@ public:
   typedef L4Re::Util::Vcon_svr<Vcon_client> My_vcon_svr;
 
   Vcon_client(std::string const &name, int color, size_t bufsz, Key key,
-              L4Re::Util::Object_registry *)
+              L4Re::Util::Object_registry *r)
   : Icu_svr(1, &_irq),
-    Client(name, color, 512, bufsz < 512 ? _dfl_obufsz : bufsz, key)
+    Client(name, color, 512, bufsz < 512 ? _dfl_obufsz : bufsz, key),
+    _registry(r)
   {}
 
+  ~Vcon_client();
+
   void vcon_write(const char *buffer, unsigned size) throw();
   unsigned vcon_read(char *buffer, unsigned size) throw();
 
   int vcon_set_attr(l4_vcon_attr_t const *a) throw();
   int vcon_get_attr(l4_vcon_attr_t *attr) throw();
+  int vcon_log_ring(L4::Cap<void> *ds, L4::Cap<L4::Irq> *irq) throw();
 
   const l4_vcon_attr_t *attr() const { return &_attr; }
 
@@ -50,7 +61,30 @@ public:
   }
 
 private:
-  enum { Default_obuf_size = 40960 };
+  /// A log ring handed out by vcon_log_ring(), drained on its doorbell.
+  struct Log_session : public L4::Irqep_t<Log_session>
+  {
+    explicit Log_session(Vcon_client *c) : c(c) {}
+    Vcon_client *c;
+    L4Re::Util::Log_ring ring;
+    L4Re::Util::Unique_cap<L4Re::Dataspace> ds;
+    L4Re::Rm::Unique_region<void *> mem;
+
+    void handle_irq()
+    { c->drain_log(this); }
+  };
+
+  void drain_log(Log_session *l);
+
+  enum
+  {
+    Default_obuf_size = 40960,
+    Log_ring_slots = 256,
+    Max_log_rings = 8,
+  };
   static unsigned _dfl_obufsz;
   Icu_svr::Irq _irq;
+
+  L4Re::Util::Object_registry *_registry;
+  std::vector<std::unique_ptr<Log_session>> _logs;
 };
@@ -0,0 +1,250 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+/*
+ * Replay an allocation trace against cxx::List_alloc and cxx::Seg_alloc.
+ *
+ * The trace is either read from a file given as the first argument or
+ * generated. Trace files use the format of moe's page allocator debug
+ * output (page_alloc_debug), one operation per line:
+ *
+ *   pa(0x1234): alloc(4096) @0x10000
+ *   pa(0x1234): free(4096) @0x10000
+ *
+ * Other lines are ignored. The program reports the replay time and, after
+ * the replay, the free memory and the number of superpages that can still
+ * be allocated.
+ */
+#include <l4/sys/consts.h>
+#include <l4/sys/kip.h>
+#include <l4/re/env.h>
+#include <l4/cxx/list_alloc>
+#include <l4/cxx/seg_alloc>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace {
+
+enum : unsigned long
+{
+  Arena_size = 256UL << 20,
+  Iterations = 20,
+};
+
+struct Op
+{
+  bool alloc;
+  unsigned long size;
+  unsigned long addr;   ///< address in the trace
+};
+
+typedef std::vector<Op> Trace;
+
+bool
+read_trace(char const *name, Trace *t)
+{
+  FILE *f = fopen(name, "r");
+  if (!f)
+    {
+      printf("Cannot open trace '%s'.\n", name);
+      return false;
+    }
+
+  char line[256];
+  while (fgets(line, sizeof(line), f))
+    {
+      char const *p = strstr(line, "): ");
+      if (!p)
+        continue;
+
+      Op o;
+      char op[6];
+      if (sscanf(p, "): %5[a-z](%lu) @%lx", op, &o.size, &o.addr) != 3
+          || !o.addr)
+        continue;
+
+      if (!strcmp(op, "alloc"))
+        o.alloc = true;
+      else if (!strcmp(op, "free"))
+        o.alloc = false;
+      else
+        continue;
+
+      t->push_back(o);
+    }
+
+  fclose(f);
+  return true;
+}
+
+/**
+ * Generate a trace resembling moe's allocation pattern: mostly single
+ * pages, some dataspace metadata blocks and occasional large, superpage
+ * sized dataspaces, freed in random order.
+ */
+void
+gen_trace(Trace *t, unsigned num)
+{
+  std::vector<Op> live;
+  unsigned long next = L4_SUPERPAGESIZE;
+
+  srand(42);
+  for (unsigned i = 0; i < num; ++i)
+    {
+      if (!live.empty() && (rand() % 100) < 45)
+        {
+          unsigned idx = rand() % live.size();
+          Op o = live[idx];
+          o.alloc = false;
+          t->push_back(o);
+          live[idx] = live.back();
+          live.pop_back();
+          continue;
+        }
+
+      unsigned r = rand() % 100;
+      unsigned long size;
+      if (r < 70)
+        size = L4_PAGESIZE;
+      else if (r < 90)
+        size = 1024 * (1 + rand() % 4);
+      else if (r < 98)
+        size = L4_PAGESIZE << (1 + rand() % 6);
+      else
+        size = L4_SUPERPAGESIZE;
+
+      Op o = { true, size, next };
+      next += l4_round_page(size) + L4_PAGESIZE;
+      t->push_back(o);
+      live.push_back(o);
+    }
+}
+
+/// Allocation requests as issued by moe.
+template<typename A>
+void *
+do_alloc(A *a, unsigned long size)
+{
+  if (size >= L4_SUPERPAGESIZE)
+    return a->alloc(size, L4_SUPERPAGESIZE);
+  if (size >= L4_PAGESIZE)
+    return a->alloc(size, L4_PAGESIZE);
+  return a->alloc(size, 1024);
+}
+
+template<typename A>
+void
+replay(char const *name, A *a, Trace const &t)
+{
+  std::map<unsigned long, std::pair<unsigned long, unsigned long>> live;
+  unsigned failed = 0;
+  l4_kernel_clock_t start = l4_kip_clock(l4re_kip());
+
+  for (unsigned it = 0; it < Iterations; ++it)
+    {
+      for (Op const &o: t)
+        {
+          if (o.alloc)
+            {
+              void *p = do_alloc(a, o.size);
+              if (!p)
+                {
+                  ++failed;
+                  continue;
+                }
+              live[o.addr] = std::make_pair((unsigned long)p, o.size);
+              continue;
+            }
+
+          // Frees may cover only a part of an allocation.
+          auto i = live.upper_bound(o.addr);
+          if (i == live.begin())
+            continue;
+          --i;
+          unsigned long off = o.addr - i->first;
+          if (off + o.size > i->second.second)
+            continue;
+
+          a->free((void *)(i->second.first + off), o.size);
+
+          // Keep track of the parts before and behind the freed range.
+          unsigned long r = i->second.first;
+          unsigned long tail = i->second.second - off - o.size;
+          if (off)
+            i->second.second = off;
+          else
+            live.erase(i);
+          if (tail)
+            live[o.addr + o.size] = std::make_pair(r + off + o.size, tail);
+        }
+
+      if (it + 1 == Iterations)
+        break;
+
+      for (auto const &l: live)
+        a->free((void *)l.second.first, l.second.second);
+      live.clear();
+    }
+
+  l4_kernel_clock_t end = l4_kip_clock(l4re_kip());
+
+  unsigned long avail = a->avail();
+  std::vector<void *> sp;
+  while (void *p = a->alloc(L4_SUPERPAGESIZE, L4_SUPERPAGESIZE))
+    sp.push_back(p);
+
+  printf("%-10s %8llu us  %5u failed  %8lu KiB free  %4zu superpages\n",
+         name, (unsigned long long)(end - start), failed, avail >> 10,
+         sp.size());
+
+  for (void *p: sp)
+    a->free(p, L4_SUPERPAGESIZE);
+  for (auto const &l: live)
+    a->free((void *)l.second.first, l.second.second);
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+  Trace t;
+  if (argc > 1)
+    {
+      if (!read_trace(argv[1], &t))
+        return 1;
+    }
+  else
+    gen_trace(&t, 20000);
+
+  printf("Replaying %zu operations %lu times on %lu MiB.\n",
+         t.size(), (unsigned long)Iterations, Arena_size >> 20);
+
+  char *arena = (char *)malloc(Arena_size + L4_SUPERPAGESIZE);
+  if (!arena)
+    {
+      printf("Cannot allocate arena.\n");
+      return 1;
+    }
+
+  // Start at an odd page so that superpages are not trivially aligned.
+  char *base = (char *)l4_round_size((l4_addr_t)arena, L4_SUPERPAGESHIFT)
+               + L4_PAGESIZE;
+
+  static cxx::List_alloc la;
+  la.free(base, Arena_size - L4_PAGESIZE, true);
+  replay("List_alloc", &la, t);
+
+  // The List_alloc run returned all memory, reuse the arena.
+  static cxx::Seg_alloc sa(L4_SUPERPAGESHIFT);
+  sa.free(base, Arena_size - L4_PAGESIZE, true);
+  replay("Seg_alloc", &sa, t);
+
+  return 0;
+}
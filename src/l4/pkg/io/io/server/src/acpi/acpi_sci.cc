@@ -58,7 +58,7 @@ AcpiOsInstallInterruptHandler (
     }
 
   Acpi_sci *sci = new Acpi_sci(service_routine, context, interrupt_number);
-  L4::Cap<L4::Irq> irq = irq_queue()->register_irq_obj(sci);
+  L4::Cap<L4::Irq> irq = irq_queue(interrupt_number)->register_irq_obj(sci);
   if (!irq.is_valid())
     {
       d_printf(DBG_ERR, "error: could not register ACPI event server\n");
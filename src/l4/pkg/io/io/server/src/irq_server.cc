@@ -4,12 +4,17 @@
  * Author(s): Alexander Warg <alexander.warg@kernkonzept.com>
  */
 
+#include <l4/re/env>
 #include <l4/re/util/object_registry>
 #include <l4/sys/cxx/ipc_server_loop>
+#include <l4/sys/scheduler>
+#include <l4/sys/sched_constraint>
 
 #include <pthread.h>
 #include <pthread-l4.h>
 #include <errno.h>
+#include <stdio.h>
+#include <map>
 
 #include "irq_server.h"
 #include "debug.h"
@@ -17,7 +22,8 @@
 namespace {
 
 typedef L4Re::Util::Registry_server<> Irq_server;
-static Irq_server *irq_server;
+static std::map<unsigned, Irq_server *> irq_servers;
+static std::map<unsigned, unsigned> irq_groups;
 
 static void *_server_loop_func(void *_svr)
 {
@@ -26,38 +32,85 @@ static void *_server_loop_func(void *_svr)
   return 0;
 }
 
-}
-
-L4Re::Util::Object_registry *irq_queue()
+static Irq_server *create_irq_server(unsigned group)
 {
-  if (irq_server)
-    return irq_server->registry();
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+
+  char name[16];
+  snprintf(name, sizeof(name), "irq_sc%u", group);
+  auto sc = L4Re::Env::env()->get_cap<L4::Sched_constraint>(name);
+  if (sc.is_valid())
+    attr.sched_constraint = sc.cap();
 
   pthread_t irq_server_thread;
-  int e = pthread_create(&irq_server_thread, NULL, NULL, NULL);
+  int e = pthread_create(&irq_server_thread, &attr, NULL, NULL);
+  pthread_attr_destroy(&attr);
   if (e != 0)
     {
-      d_printf(DBG_ERR, "fatal: could not create IRQ handler thread: %d\n",
-               -errno);
+      d_printf(DBG_ERR,
+               "fatal: could not create IRQ handler thread for group %u: %d\n",
+               group, -errno);
       return 0;
     }
 
-  irq_server = new Irq_server(Pthread::L4::utcb(irq_server_thread),
-                              Pthread::L4::cap(irq_server_thread),
-                              L4Re::Env::env()->factory());
+  Irq_server *svr = new Irq_server(Pthread::L4::utcb(irq_server_thread),
+                                   Pthread::L4::cap(irq_server_thread),
+                                   L4Re::Env::env()->factory());
 
-  e = Pthread::L4::start(irq_server_thread, _server_loop_func, irq_server);
+  e = Pthread::L4::start(irq_server_thread, _server_loop_func, svr);
   if (e < 0)
     {
-      delete irq_server;
-      irq_server = 0;
-      d_printf(DBG_ERR, "fatal: could not start IRQ handler thread: %d\n",
-               e);
+      delete svr;
+      d_printf(DBG_ERR,
+               "fatal: could not start IRQ handler thread for group %u: %d\n",
+               group, e);
       return 0;
     }
-  d_printf(DBG_DEBUG, "created IRQ handler thread\n");
-  return irq_server->registry();
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(group, &cpus);
+  e = pthread_setaffinity_np(irq_server_thread, sizeof(cpus), &cpus);
+  if (e != 0)
+    d_printf(DBG_WARN,
+             "warning: could not move IRQ handler thread to CPU %u: %d\n",
+             group, e);
+
+  d_printf(DBG_DEBUG, "created IRQ handler thread for group %u%s\n", group,
+           sc.is_valid() ? " (with scheduling constraint)" : "");
+  return svr;
+}
+
 }
 
+int set_irq_group(unsigned irq, unsigned group)
+{
+  // The group selects the CPU of the dispatch thread, it has to be online.
+  l4_sched_cpu_set_t cpus = l4_sched_cpu_set(0, 0, 0);
+  if (l4_error(L4Re::Env::env()->scheduler()->info(nullptr, &cpus)) < 0)
+    cpus.map = 1;
 
+  if (group >= L4_MWORD_BITS || !(cpus.map & (1UL << group)))
+    return -L4_ERANGE;
 
+  irq_groups[irq] = group;
+  return 0;
+}
+
+L4Re::Util::Object_registry *irq_queue(unsigned irq)
+{
+  auto g = irq_groups.find(irq);
+  unsigned group = g != irq_groups.end() ? g->second : 0;
+
+  auto s = irq_servers.find(group);
+  if (s != irq_servers.end())
+    return s->second->registry();
+
+  Irq_server *svr = create_irq_server(group);
+  if (!svr)
+    return 0;
+
+  irq_servers[group] = svr;
+  return svr->registry();
+}
@@ -7,4 +7,23 @@
 
 #include <l4/re/util/object_registry>
 
-L4Re::Util::Object_registry *irq_queue();
+/**
+ * Get the registry of the IRQ dispatch thread for interrupt `irq`.
+ *
+ * Interrupts handled within io are dispatched by one thread per IRQ group,
+ * so handlers of different groups do not delay each other. The thread of
+ * group `n` is created on first use and runs on CPU `n`. If io has a
+ * capability named `irq_sc<n>`, this scheduling constraint is attached to
+ * the thread.
+ */
+L4Re::Util::Object_registry *irq_queue(unsigned irq);
+
+/**
+ * Put interrupt `irq` into IRQ group `group`, the default group is 0.
+ *
+ * The group selects the CPU of its dispatch thread.
+ *
+ * \retval 0            Success.
+ * \retval -L4_ERANGE   CPU `group` is not online.
+ */
+int set_irq_group(unsigned irq, unsigned group);
@@ -22,6 +22,7 @@
 #include "hw_root_bus.h"
 #include "hw_device.h"
 #include "server.h"
+#include "irq_server.h"
 #include "res.h"
 #include "platform_control.h"
 #include "__acpi.h"
@@ -252,6 +253,7 @@ arg_init(int argc, char * const *argv, Io_config_x *cfg)
         OPT_TRANSPARENT_MSI   = 1,
         OPT_TRACE             = 2,
         OPT_ACPI_DEBUG        = 3,
+        OPT_IRQ_GROUP         = 4,
       };
 
       struct option opts[] =
@@ -260,6 +262,7 @@ arg_init(int argc, char * const *argv, Io_config_x *cfg)
         { "transparent-msi",   0, 0, OPT_TRANSPARENT_MSI },
         { "trace",             1, 0, OPT_TRACE },
         { "acpi-debug-level",  1, 0, OPT_ACPI_DEBUG },
+        { "irq-group",         1, 0, OPT_IRQ_GROUP },
         { 0, 0, 0, 0 },
       };
 
@@ -290,6 +293,31 @@ arg_init(int argc, char * const *argv, Io_config_x *cfg)
             printf("Set acpi debug level to 0x%08x\n", acpi_debug_level);
             break;
           }
+        case OPT_IRQ_GROUP:
+          {
+            // <irq>:<group>, the group selects the CPU dispatching the IRQ
+            char *sep;
+            unsigned irq = strtoul(optarg, &sep, 0);
+            if (*sep != ':')
+              {
+                d_printf(DBG_ERR, "invalid IRQ group '%s', use "
+                                  "--irq-group <irq>:<group>, where <group> "
+                                  "is the CPU dispatching the IRQ\n",
+                         optarg);
+                break;
+              }
+            unsigned group = strtoul(sep + 1, 0, 0);
+            if (set_irq_group(irq, group) < 0)
+              {
+                d_printf(DBG_ERR, "invalid IRQ group %u for IRQ %u: the group "
+                                  "selects the CPU, which is not online\n",
+                         group, irq);
+                break;
+              }
+            printf("Dispatch IRQ %u in IRQ group %u (CPU %u)\n", irq, group,
+                   group);
+            break;
+          }
         }
     }
   return optind;
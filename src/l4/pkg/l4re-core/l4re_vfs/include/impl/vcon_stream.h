@@ -20,6 +20,7 @@
 #include <l4/sys/capability>
 #include <l4/sys/vcon>
 #include <l4/sys/semaphore>
+#include <l4/re/util/log_ring>
 
 #include <l4/l4re_vfs/backend>
 
@@ -30,6 +31,10 @@ class Vcon_stream : public L4Re::Vfs::Be_file_stream
 private:
   L4::Cap<L4::Vcon> _s;
   L4::Cap<L4::Semaphore>  _irq;
+  L4::Cap<L4::Irq> _doorbell;
+  L4Re::Util::Log_ring _log;
+
+  void setup_log_ring() noexcept;
 
 public:
   explicit Vcon_stream(L4::Cap<L4::Vcon> s) noexcept;
@@ -17,6 +17,7 @@
  */
 
 #include <l4/re/env>
+#include <l4/re/rm>
 #include <l4/sys/factory>
 
 #include "vcon_stream.h"
@@ -39,6 +40,47 @@ Vcon_stream::Vcon_stream(L4::Cap<L4::Vcon> s) noexcept
 
   res = l4_error(_s->bind(0, _irq));
   //printf("VCON: bound irq to con res=%d\n", res);
+
+  setup_log_ring();
+}
+
+/**
+ * Map the log ring of the console if it has one, so that writes do not
+ * need IPC.
+ */
+void
+Vcon_stream::setup_log_ring() noexcept
+{
+  L4::Cap<L4Re::Dataspace> ds = L4Re::virt_cap_alloc->alloc<L4Re::Dataspace>();
+  L4::Cap<L4::Irq> db = L4Re::virt_cap_alloc->alloc<L4::Irq>();
+  if (ds.is_valid() && db.is_valid())
+    {
+      // Consoles without log ring may just reply without items.
+      l4_msgtag_t t = _s->log_ring(ds, db);
+      if (!t.has_error() && t.items() == 2)
+        {
+          unsigned long sz = ds->size();
+          void *a = 0;
+          if (L4Re::Env::env()->rm()->attach(&a, sz,
+                                             L4Re::Rm::F::Search_addr
+                                             | L4Re::Rm::F::RW,
+                                             L4::Ipc::make_cap_rw(ds)) >= 0)
+            {
+              if (_log.attach(a, sz))
+                {
+                  _doorbell = db;
+                  return;
+                }
+
+              L4Re::Env::env()->rm()->detach(a, 0);
+            }
+        }
+    }
+
+  if (ds.is_valid())
+    L4Re::virt_cap_alloc->free(ds);
+  if (db.is_valid())
+    L4Re::virt_cap_alloc->free(db);
 }
 
 ssize_t
@@ -104,6 +146,26 @@ Vcon_stream::writev(const struct iovec *iovec, int iovcnt) noexcept
       size_t sl = iovec->iov_len;
       char const *b = (char const *)iovec->iov_base;
 
+      if (_log.valid())
+        {
+          bool kick = false;
+          unsigned long l = _log.write(b, sl, &kick);
+          if (kick)
+            _doorbell->trigger();
+
+          // The console drains the ring before handling IPC writes, so
+          // the rest keeps its order if the ring is full.
+          sl -= l;
+          b += l;
+          if (!sl)
+            {
+              written += iovec->iov_len;
+              ++iovec;
+              --iovcnt;
+              continue;
+            }
+        }
+
       for (; sl > L4_VCON_WRITE_SIZE
            ; sl -= L4_VCON_WRITE_SIZE, b += L4_VCON_WRITE_SIZE)
         _s->send(b, L4_VCON_WRITE_SIZE);
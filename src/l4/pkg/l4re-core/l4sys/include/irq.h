@@ -113,6 +113,40 @@ l4_irq_detach(l4_cap_idx_t irq) L4_NOTHROW;
 L4_INLINE l4_msgtag_t
 l4_irq_detach_u(l4_cap_idx_t irq, l4_utcb_t *utcb) L4_NOTHROW;
 
+/**
+ * Limit the delivery of an IRQ by a scheduling constraint.
+ * \ingroup l4_irq_api
+ *
+ * \param irq   The IRQ object.
+ * \param sc    Scheduling constraint, #L4_INVALID_CAP to remove the limit.
+ * \param cost  Time in microseconds charged to `sc` per delivered IRQ
+ *              message.
+ *
+ * \return Syscall return tag
+ *
+ * \retval -L4_EPERM  No #L4_CAP_FPAGE_S rights on the capability used
+ *                    to invoke this operation.
+ *
+ * While the constraint does not allow running, for example while a
+ * budget constraint (L4::Budget_sc) is depleted, IRQs are not delivered
+ * but coalesced into a single message that is delivered when the
+ * constraint allows running again. The constraint need not be attached to
+ * any thread; a budget constraint is then depleted by `cost` only.
+ */
+L4_INLINE l4_msgtag_t
+l4_irq_bind_sc(l4_cap_idx_t irq, l4_cap_idx_t sc,
+               l4_umword_t cost) L4_NOTHROW;
+
+/**
+ * \ingroup l4_irq_api
+ * \copybrief L4::Irq::bind_sc
+ * \param irq  The IRQ object.
+ * \copydetails L4::Irq::bind_sc
+ */
+L4_INLINE l4_msgtag_t
+l4_irq_bind_sc_u(l4_cap_idx_t irq, l4_cap_idx_t sc, l4_umword_t cost,
+                 l4_utcb_t *utcb) L4_NOTHROW;
+
 
 /**
  * Trigger an IRQ.
@@ -214,7 +248,8 @@ l4_irq_unmask_u(l4_cap_idx_t irq, l4_utcb_t *utcb) L4_NOTHROW;
 enum L4_irq_sender_op
 {
   L4_IRQ_SENDER_OP_RESERVED1 = 0, // Ex ATTACH
-  L4_IRQ_SENDER_OP_DETACH    = 1
+  L4_IRQ_SENDER_OP_DETACH    = 1,
+  L4_IRQ_SENDER_OP_BIND_SC   = 2,
 };
 
 /**
@@ -258,6 +293,24 @@ l4_irq_detach_u(l4_cap_idx_t irq, l4_utcb_t *utcb) L4_NOTHROW
                      L4_IPC_NEVER);
 }
 
+L4_INLINE l4_msgtag_t
+l4_irq_bind_sc_u(l4_cap_idx_t irq, l4_cap_idx_t sc, l4_umword_t cost,
+                 l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  int items = 0;
+  m->mr[0] = L4_IRQ_SENDER_OP_BIND_SC;
+  m->mr[1] = cost;
+  if (!l4_is_invalid_cap(sc))
+    {
+      m->mr[2] = l4_map_obj_control(0, 0);
+      m->mr[3] = l4_obj_fpage(sc, 0, L4_CAP_FPAGE_RWS).raw;
+      items = 1;
+    }
+  return l4_ipc_call(irq, utcb, l4_msgtag(L4_PROTO_IRQ_SENDER, 2, items, 0),
+                     L4_IPC_NEVER);
+}
+
 L4_INLINE l4_msgtag_t
 l4_irq_trigger_u(l4_cap_idx_t irq, l4_utcb_t *utcb) L4_NOTHROW
 {
@@ -301,6 +354,12 @@ l4_irq_detach(l4_cap_idx_t irq) L4_NOTHROW
   return l4_irq_detach_u(irq, l4_utcb());
 }
 
+L4_INLINE l4_msgtag_t
+l4_irq_bind_sc(l4_cap_idx_t irq, l4_cap_idx_t sc, l4_umword_t cost) L4_NOTHROW
+{
+  return l4_irq_bind_sc_u(irq, sc, cost, l4_utcb());
+}
+
 L4_INLINE l4_msgtag_t
 l4_irq_trigger(l4_cap_idx_t irq) L4_NOTHROW
 {
@@ -0,0 +1,213 @@
+/**
+ * \file
+ * C interface for priority-inheritance mutexes
+ * \ingroup l4_api
+ */
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ */
+
+#pragma once
+
+#include <l4/sys/factory.h>
+#include <l4/sys/ipc.h>
+
+/**
+ * \defgroup l4_pi_mutex_api Kernel-provided priority-inheritance mutex
+ * \ingroup  l4_kernel_object_api
+ *
+ * C priority-inheritance mutex interface, see L4::Pi_mutex for the C++
+ * interface.
+ *
+ * The state of the mutex is kept in a word in kernel-user memory
+ * (L4::Task::add_ku_mem()) of the task that creates the mutex. Threads of
+ * this task acquire a free mutex by storing their own thread capability
+ * index into the word and release it by storing 0 again, both without
+ * entering the kernel. Only if that fails the mutex object is invoked.
+ *
+ * While threads wait for the mutex, the kernel raises the priority of the
+ * owner to the priority of the highest-priority waiter or, if that is
+ * lower, to the ceiling priority given at creation.
+ *
+ * \includefile{l4/sys/pi_mutex.h}
+ */
+
+enum L4_pi_mutex_op
+{
+  L4_PI_MUTEX_OP_LOCK   = 0,
+  L4_PI_MUTEX_OP_UNLOCK = 1,
+};
+
+/**
+ * \ingroup l4_pi_mutex_api
+ * Flag in the lock word: the kernel tracks the mutex.
+ */
+enum { L4_PI_MUTEX_WAITERS = 1 };
+
+/**
+ * \ingroup l4_pi_mutex_api
+ * Create a priority-inheritance mutex.
+ *
+ * \param      factory     Capability selector for factory to use for
+ *                         creation.
+ * \param[out] target_cap  The kernel stores the new mutex's capability into
+ *                         this slot.
+ * \param      word        Lock word, must be in kernel-user memory of the
+ *                         calling task and initialized to 0.
+ * \param      ceiling     Minimum priority of the owner while there are
+ *                         waiters, 0 for none.
+ *
+ * \return Syscall return tag
+ */
+L4_INLINE l4_msgtag_t
+l4_factory_create_pi_mutex(l4_cap_idx_t factory, l4_cap_idx_t target_cap,
+                           l4_umword_t *word,
+                           unsigned ceiling) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_factory_create_pi_mutex_u(l4_cap_idx_t factory, l4_cap_idx_t target_cap,
+                             l4_umword_t *word, unsigned ceiling,
+                             l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * \ingroup l4_pi_mutex_api
+ * \copybrief L4::Pi_mutex::lock()
+ * \param mutex  Mutex object.
+ * \copydetails L4::Pi_mutex::lock()
+ */
+L4_INLINE l4_msgtag_t
+l4_pi_mutex_lock(l4_cap_idx_t mutex, l4_timeout_t timeout) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_pi_mutex_lock_u(l4_cap_idx_t mutex, l4_timeout_t timeout,
+                   l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * \ingroup l4_pi_mutex_api
+ * \copybrief L4::Pi_mutex::unlock()
+ * \param mutex  Mutex object.
+ * \copydetails L4::Pi_mutex::unlock()
+ */
+L4_INLINE l4_msgtag_t
+l4_pi_mutex_unlock(l4_cap_idx_t mutex) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_pi_mutex_unlock_u(l4_cap_idx_t mutex, l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * \ingroup l4_pi_mutex_api
+ * \copybrief L4::Pi_mutex::acquire()
+ * \param mutex  Mutex object.
+ * \copydetails L4::Pi_mutex::acquire()
+ */
+L4_INLINE long
+l4_pi_mutex_acquire(l4_cap_idx_t mutex, l4_umword_t *word, l4_cap_idx_t self,
+                    l4_timeout_t timeout) L4_NOTHROW;
+
+/**
+ * \ingroup l4_pi_mutex_api
+ * \copybrief L4::Pi_mutex::release()
+ * \param mutex  Mutex object.
+ * \copydetails L4::Pi_mutex::release()
+ */
+L4_INLINE long
+l4_pi_mutex_release(l4_cap_idx_t mutex, l4_umword_t *word,
+                    l4_cap_idx_t self) L4_NOTHROW;
+
+
+/* IMPLEMENTATION -----------------------------------------------------------*/
+
+L4_INLINE l4_msgtag_t
+l4_factory_create_pi_mutex_u(l4_cap_idx_t factory, l4_cap_idx_t target_cap,
+                             l4_umword_t *word, unsigned ceiling,
+                             l4_utcb_t *u) L4_NOTHROW
+{
+  l4_msgtag_t t;
+  t = l4_factory_create_start_u(L4_PROTO_PI_MUTEX, target_cap, u);
+  l4_factory_create_add_uint_u((l4_umword_t)word, &t, u);
+  l4_factory_create_add_uint_u(ceiling, &t, u);
+  return l4_factory_create_commit_u(factory, t, u);
+}
+
+L4_INLINE l4_msgtag_t
+l4_factory_create_pi_mutex(l4_cap_idx_t factory, l4_cap_idx_t target_cap,
+                           l4_umword_t *word, unsigned ceiling) L4_NOTHROW
+{
+  return l4_factory_create_pi_mutex_u(factory, target_cap, word, ceiling,
+                                      l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_pi_mutex_lock_u(l4_cap_idx_t mutex, l4_timeout_t timeout,
+                   l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_PI_MUTEX_OP_LOCK;
+  return l4_ipc_call(mutex, utcb, l4_msgtag(L4_PROTO_PI_MUTEX, 1, 0, 0),
+                     timeout);
+}
+
+L4_INLINE l4_msgtag_t
+l4_pi_mutex_lock(l4_cap_idx_t mutex, l4_timeout_t timeout) L4_NOTHROW
+{
+  return l4_pi_mutex_lock_u(mutex, timeout, l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_pi_mutex_unlock_u(l4_cap_idx_t mutex, l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_PI_MUTEX_OP_UNLOCK;
+  return l4_ipc_call(mutex, utcb, l4_msgtag(L4_PROTO_PI_MUTEX, 1, 0, 0),
+                     L4_IPC_NEVER);
+}
+
+L4_INLINE l4_msgtag_t
+l4_pi_mutex_unlock(l4_cap_idx_t mutex) L4_NOTHROW
+{
+  return l4_pi_mutex_unlock_u(mutex, l4_utcb());
+}
+
+L4_INLINE long
+l4_pi_mutex_acquire(l4_cap_idx_t mutex, l4_umword_t *word, l4_cap_idx_t self,
+                    l4_timeout_t timeout) L4_NOTHROW
+{
+  l4_umword_t v = 0;
+  if (__atomic_compare_exchange_n(word, &v, (l4_umword_t)self, 0,
+                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return 0;
+
+  return l4_error(l4_pi_mutex_lock(mutex, timeout));
+}
+
+L4_INLINE long
+l4_pi_mutex_release(l4_cap_idx_t mutex, l4_umword_t *word,
+                    l4_cap_idx_t self) L4_NOTHROW
+{
+  l4_umword_t v = self;
+  if (__atomic_compare_exchange_n(word, &v, 0, 0,
+                                  __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    return 0;
+
+  return l4_error(l4_pi_mutex_unlock(mutex));
+}
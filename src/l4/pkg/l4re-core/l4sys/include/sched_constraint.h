@@ -9,4 +9,5 @@ enum L4_sched_constraint_type
     L4_SCHED_CONSTRAINT_TYPE_QUANT,
     L4_SCHED_CONSTRAINT_TYPE_BUDGET,
     L4_SCHED_CONSTRAINT_TYPE_TIMER_WINDOW,
+    L4_SCHED_CONSTRAINT_TYPE_GROUP = 5,
 };
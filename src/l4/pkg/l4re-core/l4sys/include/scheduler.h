@@ -268,6 +268,129 @@ L4_INLINE l4_msgtag_t
 l4_scheduler_set_prio_u(l4_cap_idx_t scheduler, l4_cap_idx_t thread,
                         l4_uint8_t const prio, l4_utcb_t *utcb) L4_NOTHROW;
 
+/**
+ * Accounted times of a scheduling constraint, in µs.
+ * \ingroup l4_scheduler_api
+ *
+ * All fields are ~0 if the capability does not refer to a scheduling
+ * constraint.
+ */
+typedef struct l4_sched_sc_stats_t
+{
+  /** Time the threads of the constraint ran. */
+  l4_uint64_t consumed;
+  /** Time the threads were ready to run but blocked by the constraint. */
+  l4_uint64_t blocked;
+  /** Time the threads were blocked by a memory-bandwidth throttle. */
+  l4_uint64_t throttled;
+} l4_sched_sc_stats_t;
+
+/**
+ * Maximum number of constraints read by one l4_scheduler_sc_stats() call.
+ * \ingroup l4_scheduler_api
+ */
+enum { L4_SCHEDULER_SC_STATS_MAX = 256 };
+
+/**
+ * \ingroup l4_scheduler_api
+ * \copybrief L4::Scheduler::sc_stats
+ *
+ * \param scheduler  Scheduler object.
+ * \copydetails L4::Scheduler::sc_stats
+ */
+L4_INLINE l4_msgtag_t
+l4_scheduler_sc_stats(l4_cap_idx_t scheduler, l4_cap_idx_t first,
+                      unsigned num, l4_sched_sc_stats_t *buf) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_scheduler_sc_stats_u(l4_cap_idx_t scheduler, l4_cap_idx_t first,
+                        unsigned num, l4_sched_sc_stats_t *buf,
+                        l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * Scheduler status of a CPU, see l4_scheduler_map_status().
+ * \ingroup l4_scheduler_api
+ *
+ * Use l4_sched_status_read() to get a consistent copy.
+ */
+typedef struct l4_sched_status_t
+{
+  /** Sequence counter, odd while the kernel updates the record. */
+  l4_umword_t seq;
+  /** Debug ID of the currently scheduled thread. */
+  l4_umword_t current;
+  /** Number of queued timeouts. */
+  l4_umword_t timeouts;
+  /** The memory-bandwidth throttle blocks the CPU. */
+  l4_umword_t mbwp_throttled;
+  /** Number of context switches. */
+  l4_uint64_t context_switches;
+  /** Number of scheduling decisions. */
+  l4_uint64_t schedules;
+  /** Number of ready threads per band of 32 priorities. */
+  l4_umword_t ready[8];
+} __attribute__((aligned(128))) l4_sched_status_t;
+
+/**
+ * \ingroup l4_scheduler_api
+ * \copybrief L4::Scheduler::map_status
+ *
+ * \param scheduler  Scheduler object.
+ * \copydetails L4::Scheduler::map_status
+ */
+L4_INLINE l4_msgtag_t
+l4_scheduler_map_status(l4_cap_idx_t scheduler, l4_addr_t addr) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_scheduler_map_status_u(l4_cap_idx_t scheduler, l4_addr_t addr,
+                          l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * Get a consistent copy of a scheduler status record.
+ * \ingroup l4_scheduler_api
+ *
+ * \param      rec  Record of a CPU in the status area.
+ * \param[out] out  Copy of the record.
+ */
+L4_INLINE void
+l4_sched_status_read(l4_sched_status_t const *rec,
+                     l4_sched_status_t *out) L4_NOTHROW;
+
+/**
+ * Scheduling policies of a priority band.
+ * \ingroup l4_scheduler_api
+ */
+enum L4_sched_band_policy
+{
+  L4_SCHED_BAND_FIXED_PRIO = 0, /**< Threads ordered by priority */
+  L4_SCHED_BAND_EDF        = 1, /**< Threads ordered by deadline */
+  L4_SCHED_BAND_FAIR       = 2, /**< Threads share the CPU by weight */
+};
+
+/**
+ * \ingroup l4_scheduler_api
+ * \copybrief L4::Scheduler::set_band_policy
+ *
+ * \param scheduler  Scheduler object.
+ * \copydetails L4::Scheduler::set_band_policy
+ */
+L4_INLINE l4_msgtag_t
+l4_scheduler_set_band_policy(l4_cap_idx_t scheduler, unsigned band,
+                             unsigned policy) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_scheduler_set_band_policy_u(l4_cap_idx_t scheduler, unsigned band,
+                               unsigned policy, l4_utcb_t *utcb) L4_NOTHROW;
+
 /**
  * Operations on the Scheduler object.
  * \ingroup l4_scheduler_api
@@ -283,6 +406,10 @@ enum L4_scheduler_ops
   L4_SCHEDULER_ATTACH_SC_OP      = 4UL,
   L4_SCHEDULER_DETACH_SC_OP      = 5UL,
   L4_SCHEDULER_SET_GLOBAL_SC_OP  = 6UL,
+  L4_SCHEDULER_STEAL_TIME_OP     = 7UL, /**< Query constraint-blocked time of a thread */
+  L4_SCHEDULER_SC_STATS_OP       = 8UL, /**< Query accounted times of constraints */
+  L4_SCHEDULER_MAP_STATUS_OP     = 9UL, /**< Map the scheduler status area */
+  L4_SCHEDULER_SET_BAND_POLICY_OP = 10UL, /**< Select the policy of a priority band */
 };
 
 /*************** Implementations *******************/
@@ -415,6 +542,20 @@ l4_scheduler_set_prio_u(l4_cap_idx_t scheduler, l4_cap_idx_t thread,
   return l4_ipc_call(scheduler, utcb, l4_msgtag(L4_PROTO_SCHEDULER, 2, 1, 0), L4_IPC_NEVER);
 }
 
+L4_INLINE l4_msgtag_t
+l4_scheduler_sc_stats_u(l4_cap_idx_t scheduler, l4_cap_idx_t first,
+                        unsigned num, l4_sched_sc_stats_t *buf,
+                        l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_SCHEDULER_SC_STATS_OP;
+  m->mr[1] = first;
+  m->mr[2] = num;
+  m->mr[3] = (l4_umword_t)buf;
+
+  return l4_ipc_call(scheduler, utcb, l4_msgtag(L4_PROTO_SCHEDULER, 4, 0, 0), L4_IPC_NEVER);
+}
+
 
 L4_INLINE l4_msgtag_t
 l4_scheduler_info(l4_cap_idx_t scheduler, l4_umword_t *cpu_max,
@@ -464,3 +605,62 @@ l4_scheduler_set_prio(l4_cap_idx_t scheduler, l4_cap_idx_t thread,
 {
   return l4_scheduler_set_prio_u(scheduler, thread, prio, l4_utcb());
 }
+
+L4_INLINE l4_msgtag_t
+l4_scheduler_sc_stats(l4_cap_idx_t scheduler, l4_cap_idx_t first,
+                      unsigned num, l4_sched_sc_stats_t *buf) L4_NOTHROW
+{
+  return l4_scheduler_sc_stats_u(scheduler, first, num, buf, l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_scheduler_map_status_u(l4_cap_idx_t scheduler, l4_addr_t addr,
+                          l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_SCHEDULER_MAP_STATUS_OP;
+  m->mr[1] = addr;
+
+  return l4_ipc_call(scheduler, utcb, l4_msgtag(L4_PROTO_SCHEDULER, 2, 0, 0), L4_IPC_NEVER);
+}
+
+L4_INLINE l4_msgtag_t
+l4_scheduler_map_status(l4_cap_idx_t scheduler, l4_addr_t addr) L4_NOTHROW
+{
+  return l4_scheduler_map_status_u(scheduler, addr, l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_scheduler_set_band_policy_u(l4_cap_idx_t scheduler, unsigned band,
+                               unsigned policy, l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_SCHEDULER_SET_BAND_POLICY_OP;
+  m->mr[1] = band;
+  m->mr[2] = policy;
+
+  return l4_ipc_call(scheduler, utcb, l4_msgtag(L4_PROTO_SCHEDULER, 3, 0, 0), L4_IPC_NEVER);
+}
+
+L4_INLINE l4_msgtag_t
+l4_scheduler_set_band_policy(l4_cap_idx_t scheduler, unsigned band,
+                             unsigned policy) L4_NOTHROW
+{
+  return l4_scheduler_set_band_policy_u(scheduler, band, policy, l4_utcb());
+}
+
+L4_INLINE void
+l4_sched_status_read(l4_sched_status_t const *rec,
+                     l4_sched_status_t *out) L4_NOTHROW
+{
+  l4_umword_t s;
+  do
+    {
+      while ((s = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE)) & 1)
+        ;
+      __builtin_memcpy(out, (void const *)rec, sizeof(*out));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    }
+  while (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != s);
+  out->seq = s;
+}
@@ -76,6 +76,7 @@ enum L4_msgtag_protocol
   L4_PROTO_DEBUGGER      = -23L, ///< Protocol ID for the debugger
   L4_PROTO_SMCCC         = -24L, ///< Protocol ID for ARM SMCCC calls
   L4_PROTO_SCHED_CONSTRAINT = -25L, ///< Protocol for messages to a scheduling context
+  L4_PROTO_PI_MUTEX      = -26L, ///< Protocol for priority-inheritance mutexes
 };
 
 enum L4_varg_type
@@ -284,6 +284,33 @@ L4_INLINE l4_msgtag_t
 l4_vcon_get_attr_u(l4_cap_idx_t vcon, l4_vcon_attr_t *attr,
                    l4_utcb_t *utcb) L4_NOTHROW;
 
+/**
+ * Request the shared-memory log ring of a Vcon.
+ * \ingroup l4_vcon_api
+ *
+ * \param vcon  Vcon object.
+ * \param ds    Capability slot to receive the dataspace of the ring.
+ * \param irq   Capability slot to receive the doorbell IRQ.
+ * \return Syscall return tag, the reply carries two items on success.
+ *
+ * Not all Vcon servers provide a log ring. Servers that do not know the
+ * operation may reply without items and without an error, so callers have
+ * to check l4_msgtag_items() of the returned tag.
+ */
+L4_INLINE l4_msgtag_t
+l4_vcon_log_ring(l4_cap_idx_t vcon, l4_cap_idx_t ds,
+                 l4_cap_idx_t irq) L4_NOTHROW;
+
+/**
+ * \ingroup l4_vcon_api
+ * \copybrief L4::Vcon::log_ring
+ * \param vcon  Capability index of the vcon object.
+ * \copydetails L4::Vcon::log_ring
+ */
+L4_INLINE l4_msgtag_t
+l4_vcon_log_ring_u(l4_cap_idx_t vcon, l4_cap_idx_t ds, l4_cap_idx_t irq,
+                   l4_utcb_t *utcb) L4_NOTHROW;
+
 /**
  * \copydoc l4_vcon_attr_t::set_raw
  * \ingroup l4_vcon_api
@@ -303,6 +330,7 @@ enum L4_vcon_ops
   L4_VCON_READ_OP        = 1UL,    /**< Read */
   L4_VCON_SET_ATTR_OP    = 2UL,    /**< Get console attributes */
   L4_VCON_GET_ATTR_OP    = 3UL,    /**< Set console attributes */
+  L4_VCON_LOG_RING_OP    = 4UL,    /**< Get shared-memory log ring */
 };
 
 /******* Implementations ********************/
@@ -446,6 +474,30 @@ l4_vcon_get_attr(l4_cap_idx_t vcon, l4_vcon_attr_t *attr) L4_NOTHROW
   return l4_vcon_get_attr_u(vcon, attr, l4_utcb());
 }
 
+L4_INLINE l4_msgtag_t
+l4_vcon_log_ring_u(l4_cap_idx_t vcon, l4_cap_idx_t ds, l4_cap_idx_t irq,
+                   l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *mr = l4_utcb_mr_u(utcb);
+  l4_buf_regs_t *br = l4_utcb_br_u(utcb);
+
+  mr->mr[0] = L4_VCON_LOG_RING_OP;
+  br->bdr = 0;
+  br->br[0] = ds | L4_RCV_ITEM_SINGLE_CAP;
+  br->br[1] = irq | L4_RCV_ITEM_SINGLE_CAP;
+
+  return l4_ipc_call(vcon, utcb,
+                     l4_msgtag(L4_PROTO_LOG, 1, 0, 0),
+                     L4_IPC_NEVER);
+}
+
+L4_INLINE l4_msgtag_t
+l4_vcon_log_ring(l4_cap_idx_t vcon, l4_cap_idx_t ds,
+                 l4_cap_idx_t irq) L4_NOTHROW
+{
+  return l4_vcon_log_ring_u(vcon, ds, irq, l4_utcb());
+}
+
 L4_INLINE void
 l4_vcon_set_attr_raw(l4_vcon_attr_t *attr) L4_NOTHROW
 {
@@ -10,6 +10,7 @@
 #include "dataspace_noncont.h"
 #include "quota.h"
 #include "pages.h"
+#include "zero_pool.h"
 
 #include <l4/sys/task.h>
 #include <l4/sys/cache.h>
@@ -22,6 +23,8 @@
 
 using cxx::min;
 
+unsigned char Moe::Dataspace_noncont::fault_around;
+
 void
 Moe::Dataspace_noncont::unmap_page(Page const &p, bool ro) const noexcept
 {
@@ -45,7 +48,9 @@ Moe::Dataspace_noncont::free_page(Page &p) const noexcept
 }
 
 Moe::Dataspace::Address
-Moe::Dataspace_noncont::map_address(l4_addr_t offset, Flags flags) const
+Moe::Dataspace_noncont::map_address(l4_addr_t offset, Flags flags,
+                                    l4_addr_t hot_spot, l4_addr_t min,
+                                    l4_addr_t max, bool around) const
 {
   // XXX: There may be a problem with data spaces with
   //      page_size() > L4_PAGE_SIZE
@@ -82,28 +87,162 @@ Moe::Dataspace_noncont::map_address(l4_addr_t offset, Flags flags) const
     }
 
   if (!*p)
+    populate(offset, p, around);
+
+  unsigned shift = page_shift() + map_order(offset, flags, hot_spot, min, max);
+  l4_addr_t start = l4_trunc_size(offset, shift);
+  return Address(l4_addr_t(*page(start)), shift, flags,
+                 offset & ((1UL << shift) - 1));
+}
+
+/**
+ * Back the page at `offset` with memory.
+ *
+ * If `around` is set and the fault-around window containing the page is
+ * unpopulated, the whole window is populated from a single contiguous
+ * allocation.
+ */
+void
+Moe::Dataspace_noncont::populate(l4_addr_t offset, Page &p, bool around) const
+{
+  unsigned order = around ? fault_around : 0;
+  for (; order; --order)
+    {
+      unsigned long sz = page_size() << order;
+      l4_addr_t start = l4_trunc_size(offset, page_shift() + order);
+      if (start + sz > round_size())
+        continue;
+
+      bool empty = true;
+      for (l4_addr_t o = start; o < start + sz && empty; o += page_size())
+        empty = !page(o).valid();
+
+      if (empty)
+        break;
+    }
+
+  unsigned long sz = page_size() << order;
+  void *m = 0;
+  if (order)
+    {
+      // Fall back to a single page if the window cannot be allocated.
+      try
+        {
+          m = alloc_zeroed(sz);
+        }
+      catch (L4::Out_of_memory const &)
+        {
+          sz = page_size();
+        }
+    }
+
+  if (!m)
+    m = alloc_zeroed(sz);
+
+  if (sz == page_size())
+    {
+      p.set(m, 0);
+      Moe::Pages::share(m);
+      return;
+    }
+
+  l4_addr_t start = l4_trunc_size(offset, page_shift() + order);
+  for (unsigned long o = 0; o < sz; o += page_size())
     {
-      p.set(qalloc()->alloc_pages(page_size(), page_size()), 0);
-      Moe::Pages::share(*p);
-      memset(*p, 0, page_size());
-      // No need for I cache coherence, as we just zero fill and assume that
-      // this is no executable code
-      l4_cache_clean_data((l4_addr_t)*p, (l4_addr_t)(*p) + page_size());
+      Page &n = alloc_page(start + o);
+      n.set((char *)m + o, 0);
+      Moe::Pages::share(*n);
+    }
+}
+
+/**
+ * Allocate a zeroed block of `sz` bytes aligned to its size.
+ *
+ * Takes a block from the zero page pool if possible.
+ */
+void *
+Moe::Dataspace_noncont::alloc_zeroed(unsigned long sz) const
+{
+  {
+    Quota_guard g(qalloc()->quota(), sz);
+    if (void *m = Zero_pool::take(sz))
+      return g.release(m);
+  }
+
+  void *m = qalloc()->alloc_pages(sz, sz);
+  memset(m, 0, sz);
+  // No need for I cache coherence, as we just zero fill and assume that
+  // this is no executable code
+  l4_cache_clean_data((l4_addr_t)m, (l4_addr_t)m + sz);
+  return m;
+}
+
+/**
+ * Find the largest flexpage that can be mapped for a fault at `offset`.
+ *
+ * A naturally aligned range of pages can be mapped at once up to superpage
+ * size if it is fully populated with physically contiguous and equally
+ * aligned memory. For write access, none of the pages may be copy-on-write.
+ * As in Dataspace_cont::address(), the flexpage must also be placed at
+ * `offset` relative to `hot_spot` in the receive window and must fit into
+ * [`min`, `max`] there.
+ *
+ * \return Log2 of the number of pages to map.
+ */
+unsigned
+Moe::Dataspace_noncont::map_order(l4_addr_t offset, Flags flags,
+                                  l4_addr_t hot_spot, l4_addr_t min,
+                                  l4_addr_t max) const
+{
+  min = l4_trunc_page(min);
+
+  unsigned order = 0;
+  for (unsigned o = 1; page_shift() + o <= L4_SUPERPAGESHIFT; ++o)
+    {
+      unsigned long sz = page_size() << o;
+      l4_addr_t start = l4_trunc_size(offset, page_shift() + o);
+      if (start + sz > round_size())
+        break;
+
+      l4_addr_t map_base = l4_trunc_size(hot_spot, page_shift() + o);
+      if (map_base < min || map_base + sz - 1 > max)
+        break;
+
+      if (hot_spot == ~0UL || ((offset ^ hot_spot) & (sz - 1)))
+        break;
+
+      l4_addr_t base = (l4_addr_t)*page(start);
+      if (!base || (base & (sz - 1)))
+        break;
+
+      for (l4_addr_t i = 0; i < sz; i += page_size())
+        {
+          Page const &q = page(start + i);
+          if ((l4_addr_t)*q != base + i
+              || (flags.w() && (q.flags() & Page_cow)))
+            return order;
+        }
+
+      order = o;
     }
 
-  return Address(l4_addr_t(*p), page_shift(), flags, offset & (page_size()-1));
+  return order;
 }
 
 Moe::Dataspace::Address
-Moe::Dataspace_noncont::address(l4_addr_t offset, Flags flags, l4_addr_t,
-                                l4_addr_t, l4_addr_t) const
-{ return map_address(offset, flags); }
+Moe::Dataspace_noncont::address(l4_addr_t offset, Flags flags,
+                                l4_addr_t hot_spot, l4_addr_t min,
+                                l4_addr_t max) const
+{ return map_address(offset, flags, hot_spot, min, max); }
 
 int
 Moe::Dataspace_noncont::copy_address(l4_addr_t offset, Flags flags,
                                      l4_addr_t *addr, unsigned long *size) const
 {
-  auto a = map_address(offset, flags);
+  // Copies are not faults: only back the pages that are actually written,
+  // e.g. just the partial BSS page when loading an ELF data segment. There
+  // is no receive window, so any contiguous range may be copied at once.
+  auto a = map_address(offset, flags, offset, 0, ~0UL, false);
   if (a.is_nil())
     return -L4_ERANGE;
 
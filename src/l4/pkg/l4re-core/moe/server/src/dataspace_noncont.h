@@ -98,6 +98,15 @@ public:
   static Dataspace_noncont *create(Q_alloc *q, unsigned long size,
                                    Flags flags = L4Re::Dataspace::F::RWX);
 
+  /**
+   * Log2 of the number of pages populated on a fault in an unpopulated
+   * region (fault-around window), 0 for a single page.
+   *
+   * The window is aligned to its size and backed by physically contiguous
+   * memory, so it can be mapped with a single flexpage.
+   */
+  static unsigned char fault_around;
+
 protected:
   union
   {
@@ -106,6 +115,11 @@ protected:
   };
 
 private:
-  Address map_address(l4_addr_t offset, Flags flags) const;
+  Address map_address(l4_addr_t offset, Flags flags, l4_addr_t hot_spot,
+                      l4_addr_t min, l4_addr_t max, bool around = true) const;
+  void populate(l4_addr_t offset, Page &p, bool around) const;
+  void *alloc_zeroed(unsigned long sz) const;
+  unsigned map_order(l4_addr_t offset, Flags flags, l4_addr_t hot_spot,
+                     l4_addr_t min, l4_addr_t max) const;
 };
 };
@@ -41,6 +41,8 @@
 #include "pages.h"
 #include "vesa_fb.h"
 #include "dataspace_static.h"
+#include "dataspace_noncont.h"
+#include "zero_pool.h"
 #include "debug.h"
 #include "args.h"
 
@@ -429,11 +431,26 @@ static void hdl_ldr_flags(cxx::String const &args)
 
 
 
+static void hdl_fault_around(cxx::String const &args)
+{
+  unsigned order;
+  if (args.empty() || args.from_dec(&order) != args.len()
+      || order > L4_SUPERPAGESHIFT - L4_PAGESHIFT)
+    {
+      warn.printf("invalid argument for --fault-around: '%.*s'\n",
+                  args.len(), args.start());
+      return;
+    }
+
+  Moe::Dataspace_noncont::fault_around = order;
+}
+
 static Get_opt const _options[] = {
       {"--debug=",     hdl_debug },
       {"--init=",      hdl_init },
       {"--l4re-dbg=",  hdl_l4re_dbg },
       {"--ldr-flags=", hdl_ldr_flags },
+      {"--fault-around=", hdl_fault_around },
       {0, 0}
 };
 
@@ -584,6 +601,7 @@ int main(int argc, char**argv)
       info.printf("cmdline: %s\n", cmdline);
 
       bool skip_argv0 = true;
+      cxx::String init_args("");
       cxx::Pair<cxx::String, cxx::String> a;
       for (a = next_arg(cmdline); !a.first.empty(); a = next_arg(a.second))
         {
@@ -595,22 +613,22 @@ int main(int argc, char**argv)
 
           if (a.first[0] != '-') // not an option start init
             {
-              elf_loader.start(_init_prog, cxx::String(a.first.start(),
-                                                       a.second.end()));
+              init_args = cxx::String(a.first.start(), a.second.end());
               break;
             }
 
           if (a.first == "--")
             {
-              elf_loader.start(_init_prog, a.second);
+              init_args = a.second;
               break;
             }
 
           parse_option(a.first);
         }
 
-      if (a.first.empty())
-        elf_loader.start(_init_prog, cxx::String(""));
+      Moe::Zero_pool::init(Moe::Dataspace_noncont::fault_around);
+
+      elf_loader.start(_init_prog, init_args);
 
       // dump name space information
       if (boot.is_active())
@@ -9,8 +9,9 @@
 #include <l4/util/util.h>
 
 #include <l4/cxx/iostream>
-#include <l4/cxx/list_alloc>
+#include <l4/cxx/seg_alloc>
 #include <l4/cxx/exceptions>
+#include <l4/sys/consts.h>
 #include <l4/sys/kdebug.h>
 #include "page_alloc.h"
 #include "debug.h"
@@ -21,8 +22,12 @@ enum { page_alloc_debug = 0 };
 unsigned page_alloc_debug = 0;
 #endif
 
-class LA : public cxx::List_alloc
+class LA : public cxx::Seg_alloc
 {
+public:
+  // Try to keep superpages intact for large anonymous dataspaces.
+  LA() : cxx::Seg_alloc(L4_SUPERPAGESHIFT) {}
+
 #if 0
 public:
   ~LA()
@@ -35,7 +40,7 @@ public:
   void *alloc(unsigned long size, unsigned long align)
   {
     L4::cout << "PA::alloc: " << L4::hex << size << '(' << align << ") -> \n";
-    void *p = cxx::List_alloc::alloc(size, align);
+    void *p = cxx::Seg_alloc::alloc(size, align);
     L4::cout << p << "\n";
     return p;
   }
@@ -45,7 +50,7 @@ public:
   void free(void *p, unsigned long size)
   {
     L4::cout << "free: " << p << '(' << size << ") -> ";
-    cxx::List_alloc::free(p, size);
+    cxx::Seg_alloc::free(p, size);
     L4::cout << avail() << "\n";
   }
 #endif
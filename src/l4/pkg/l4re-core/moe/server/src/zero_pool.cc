@@ -0,0 +1,197 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#include "zero_pool.h"
+#include "debug.h"
+#include "globals.h"
+#include "page_alloc.h"
+
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/sys/cache.h>
+#include <l4/sys/debugger.h>
+#include <l4/sys/sched_constraint>
+#include <l4/sys/scheduler>
+#include <l4/sys/thread>
+#include <l4/sys/utcb.h>
+
+#include <cstring>
+
+namespace {
+
+enum
+{
+  Scrubber_prio   = 1,
+  // The scrubber may use 1ms of CPU time in every 10ms.
+  Scrubber_budget = 1000,
+  Scrubber_period = 10000,
+};
+
+char scrubber_stack[L4_PAGESIZE] __attribute__((aligned(16)));
+
+}
+
+Moe::Zero_pool Moe::Zero_pool::_pools[Num_pools];
+L4::Cap<L4::Irq> Moe::Zero_pool::_irq;
+
+void
+Moe::Zero_pool::setup(unsigned char shift)
+{
+  _shift = shift;
+  _cap = Max_bytes >> shift;
+  if (_cap > Ring_size)
+    _cap = Ring_size;
+}
+
+/// Main thread: take a ready block.
+void *
+Moe::Zero_pool::get()
+{
+  if (_head == __atomic_load_n(&_clean, __ATOMIC_ACQUIRE))
+    return nullptr;
+
+  return _ring[_head++ % Ring_size];
+}
+
+/**
+ * Main thread: queue fresh blocks for the scrubber.
+ *
+ * \return true if blocks were queued.
+ */
+bool
+Moe::Zero_pool::fill()
+{
+  bool queued = false;
+  while (_tail - _head < _cap)
+    {
+      void *b = Single_page_alloc_base::_alloc(Single_page_alloc_base::nothrow,
+                                               size(), size());
+      if (!b)
+        break;
+
+      _ring[_tail % Ring_size] = b;
+      __atomic_store_n(&_tail, _tail + 1, __ATOMIC_RELEASE);
+      queued = true;
+    }
+
+  return queued;
+}
+
+/// Scrubber: zero all queued blocks.
+void
+Moe::Zero_pool::scrub()
+{
+  unsigned tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+  for (unsigned c = _clean; c != tail; ++c)
+    {
+      l4_addr_t b = (l4_addr_t)_ring[c % Ring_size];
+      memset((void *)b, 0, size());
+      // No need for I cache coherence, as we just zero fill and assume that
+      // this is no executable code
+      l4_cache_clean_data(b, b + size());
+      __atomic_store_n(&_clean, c + 1, __ATOMIC_RELEASE);
+    }
+}
+
+void
+Moe::Zero_pool::scrubber()
+{
+  for (;;)
+    {
+      for (auto &p: _pools)
+        if (p._cap)
+          p.scrub();
+
+      l4_irq_receive(_irq.cap(), L4_IPC_NEVER);
+    }
+}
+
+void
+Moe::Zero_pool::init(unsigned window_order)
+{
+  Dbg warn(Dbg::Warn);
+
+  try
+    {
+      auto *e = L4Re::Env::env();
+      auto *ca = object_pool.cap_alloc();
+
+      auto thread = L4Re::chkcap(ca->alloc<L4::Thread>(),
+                                 "Allocate scrubber thread capability");
+      auto irq = L4Re::chkcap(ca->alloc<L4::Irq>(),
+                              "Allocate scrubber IRQ capability");
+      auto sc = L4Re::chkcap(ca->alloc<L4::Budget_sc>(),
+                             "Allocate scrubber constraint capability");
+
+      L4Re::chksys(e->factory()->create(thread), "Create scrubber thread");
+      L4Re::chksys(e->factory()->create(irq), "Create scrubber IRQ");
+
+      auto cs = e->factory()->create(sc);
+      cs << l4_umword_t(L4_SCHED_CONSTRAINT_TYPE_BUDGET);
+      cs << l4_umword_t(Scrubber_budget);
+      cs << l4_umword_t(Scrubber_period);
+      L4Re::chksys(cs, "Create scrubber budget constraint");
+
+      // The kernel provides a page of UTCBs, the first one is ours.
+      L4::Thread::Attr attr;
+      attr.pager(L4::Cap<void>(L4_BASE_PAGER_CAP));
+      attr.exc_handler(L4::Cap<void>(L4_BASE_PAGER_CAP));
+      attr.bind((l4_utcb_t *)((char *)l4_utcb() + L4_UTCB_OFFSET),
+                L4Re::This_task);
+      L4Re::chksys(thread->control(attr), "Bind scrubber thread");
+      L4Re::chksys(irq->bind_thread(thread, 0), "Bind scrubber IRQ");
+      L4Re::chksys(e->scheduler()->attach_sc(thread, sc),
+                   "Attach scrubber budget constraint");
+
+      _irq = irq;
+      _pools[0].setup(L4_PAGESHIFT);
+      if (window_order)
+        _pools[1].setup(L4_PAGESHIFT + window_order);
+
+      for (auto &p: _pools)
+        if (p._cap)
+          p.fill();
+
+      L4Re::chksys(thread->ex_regs((l4_umword_t)scrubber,
+                                   (l4_umword_t)scrubber_stack
+                                   + sizeof(scrubber_stack), 0),
+                   "Start scrubber thread");
+      L4Re::chksys(e->scheduler()->run_thread(thread,
+                                              l4_sched_param(Scrubber_prio)),
+                   "Schedule scrubber thread");
+      l4_debugger_set_object_name(thread.cap(), "moe-scrub");
+    }
+  catch (L4::Runtime_error const &e)
+    {
+      warn.printf("zero page pool disabled: %s (%ld)\n", e.extra_str(),
+                  e.err_no());
+      // Nobody zeroes queued blocks, so return them.
+      for (auto &p: _pools)
+        {
+          for (; p._head != p._tail; ++p._head)
+            Single_page_alloc_base::_free(p._ring[p._head % Ring_size],
+                                          p.size());
+          p._cap = 0;
+        }
+    }
+}
+
+void *
+Moe::Zero_pool::take(unsigned long size)
+{
+  for (auto &p: _pools)
+    {
+      if (!p._cap || p.size() != size)
+        continue;
+
+      void *b = p.get();
+      if (p._tail - p._head <= p._cap / 2 && p.fill())
+        _irq->trigger();
+
+      return b;
+    }
+
+  return nullptr;
+}
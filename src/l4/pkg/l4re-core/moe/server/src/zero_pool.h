@@ -0,0 +1,78 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+#include <l4/sys/irq>
+
+namespace Moe {
+
+/**
+ * Pool of zeroed memory blocks of a single size.
+ *
+ * Moe's main thread, which owns the page allocator, puts blocks into the
+ * pool. A low-priority background thread (the scrubber) zeroes them and
+ * cleans the data cache, so page faults on anonymous memory can take a
+ * ready block instead of zeroing memory in the fault path.
+ *
+ * The blocks of a pool are kept in a ring: entries [head, clean) are
+ * ready, entries [clean, tail) still need to be zeroed. Only the main
+ * thread moves head and tail, only the scrubber moves clean.
+ */
+class Zero_pool
+{
+public:
+  enum
+  {
+    Ring_size = 32,         ///< Maximum number of blocks in a pool
+    Max_bytes = 256 << 10,  ///< Maximum amount of memory in a pool
+  };
+
+  /**
+   * Start the scrubber thread and fill the pools.
+   *
+   * There is one pool for single pages and, if `window_order` is not 0,
+   * one for fault-around windows of 2^window_order pages.
+   *
+   * If the scrubber cannot be started, all pools stay empty.
+   */
+  static void init(unsigned window_order);
+
+  /**
+   * Take a zeroed block.
+   *
+   * \param size  Size of the block.
+   *
+   * \return A zeroed, cache-cleaned block aligned to its size, or nullptr
+   *         if there is no pool for `size` or the pool is empty.
+   *
+   * The caller is responsible for accounting the block to a quota.
+   */
+  static void *take(unsigned long size);
+
+private:
+  enum { Num_pools = 2 };
+
+  unsigned long size() const { return 1UL << _shift; }
+
+  void setup(unsigned char shift);
+  void *get();
+  bool fill();
+  void scrub();
+
+  [[noreturn]] static void scrubber();
+
+  unsigned char _shift = 0;
+  unsigned _cap = 0;
+  unsigned _head = 0;
+  unsigned _clean = 0;
+  unsigned _tail = 0;
+  void *_ring[Ring_size];
+
+  static Zero_pool _pools[Num_pools];
+  static L4::Cap<L4::Irq> _irq;
+};
+
+}
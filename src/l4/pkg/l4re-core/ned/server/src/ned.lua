@@ -83,6 +83,7 @@ SC_types = {
   Budget_sc       = 2,
   Timer_window_sc = 3,
   Mbw_sc          = 4,
+  Group_sc        = 5,
 }
 
 -- Loader class, encapsulates a loader instance.
@@ -52,6 +52,7 @@ typedef struct __pthread_attr_s
   // L4 specifics
   l4_sched_cpu_set_t affinity;
   unsigned create_flags;
+  l4_cap_idx_t sched_constraint; // additionally attached on start if valid
 
 } pthread_attr_t;
 
@@ -53,6 +53,7 @@ __pthread_attr_init(pthread_attr_t *attr)
   // L4 specifics
   attr->affinity = l4_sched_cpu_set(0, ~0, 1);
   attr->create_flags = 0;
+  attr->sched_constraint = L4_INVALID_CAP;
   return 0;
 }
 strong_alias (__pthread_attr_init, pthread_attr_init)
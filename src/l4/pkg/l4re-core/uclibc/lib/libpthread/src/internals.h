@@ -162,6 +162,11 @@ extern __volatile__ int __pthread_threads_debug;
 /* Flag which tells whether we are executing on SMP kernel. */
 extern int __pthread_smp_kernel;
 
+/* Spin iterations suspend() waits for a restart() before blocking in the
+   kernel; -1 until calibrated by the first suspend(), 0 on uniprocessor
+   systems. */
+extern int __pthread_l4_spin_count;
+
 inline static void __pthread_send_manager_rq(struct pthread_request *r, int block)
 {
   if (l4_is_invalid_cap(__pthread_manager_request))
@@ -298,6 +303,7 @@ extern int __librt_multiple_threads;
 /* Internal global functions */
 __BEGIN_DECLS
 extern int __pthread_l4_initialize_main_thread(pthread_descr th) attribute_hidden;
+extern void __pthread_l4_calibrate_spin(pthread_descr self) attribute_hidden;
 extern void __l4_add_utcbs(l4_addr_t utcbs_start, l4_addr_t utcbs_end);
 
 /* L4Re: Interpret user[2] as pointer to the next free UTCB. */
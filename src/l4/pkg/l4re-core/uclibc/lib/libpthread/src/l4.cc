@@ -11,6 +11,8 @@
 #include <l4/re/util/cap_alloc>
 #include <l4/sys/kdebug.h>
 #include <l4/sys/scheduler>
+#include <l4/sys/semaphore.h>
+#include <l4/re/env.h>
 
 #include <pthread-l4.h>
 #include <errno.h>
@@ -96,6 +98,75 @@ int __pthread_l4_initialize_main_thread(pthread_descr th)
 }
 
 
+int __pthread_l4_spin_count = -1;
+
+enum
+{
+  Spin_calibrate_us = 100, ///< Time spent measuring the semaphore round trip
+  Spin_min          = 16,
+  Spin_max          = 1 << 14,
+};
+
+/**
+ * Calibrate the spin phase of suspend().
+ *
+ * Spinning pays off as long as it is shorter than blocking and being woken
+ * up again, so spin for about as long as a semaphore up/down pair takes.
+ * The round trip measured here does not block and thus is a lower bound of
+ * the real cost. Spinning is disabled if only one CPU is online.
+ *
+ * The calibration takes up to a few ticks of the KIP clock, so it is done by
+ * the first suspend() of the process rather than at startup: processes that
+ * never wait for another thread do not pay for it. Threads that race here
+ * calibrate in parallel and store similar results.
+ */
+void __pthread_l4_calibrate_spin(pthread_descr self)
+{
+  L4Re::Env const *env = L4Re::Env::env();
+  l4_sched_cpu_set_t cpus = l4_sched_cpu_set(0, 0, 0);
+  if (l4_error(env->scheduler()->info(nullptr, &cpus)) < 0
+      || !(cpus.map & (cpus.map - 1)))
+    {
+      __atomic_store_n(&__pthread_l4_spin_count, 0, __ATOMIC_RELAXED);
+      return;
+    }
+
+  l4_kernel_info_t const *kip = l4re_kip();
+  unsigned long rounds = 0;
+  l4_cpu_time_t start = l4_kip_clock(kip);
+  l4_cpu_time_t elapsed;
+  do
+    {
+      l4_semaphore_up(self->p_thsem_cap);
+      l4_semaphore_down(self->p_thsem_cap, L4_IPC_NEVER);
+      ++rounds;
+    }
+  while ((elapsed = l4_kip_clock(kip) - start) < Spin_calibrate_us);
+
+  unsigned long spins = 0;
+  start = l4_kip_clock(kip);
+  do
+    {
+      for (unsigned i = 0; i < 64; ++i)
+        {
+#ifdef BUSY_WAIT_NOP
+          BUSY_WAIT_NOP;
+#endif
+          __asm__ __volatile__ ("" : : : "memory");
+        }
+      spins += 64;
+    }
+  while (l4_kip_clock(kip) - start < elapsed);
+
+  unsigned long c = spins / rounds;
+  if (c < Spin_min)
+    c = Spin_min;
+  if (c > Spin_max)
+    c = Spin_max;
+
+  __atomic_store_n(&__pthread_l4_spin_count, (int)c, __ATOMIC_RELAXED);
+}
+
 int __attribute__((weak)) __pthread_sched_idle_prio    = 0x01;
 int __attribute__((weak)) __pthread_sched_other_prio   = 0x02;
 int __attribute__((weak)) __pthread_sched_rr_prio_min  = 0x40;
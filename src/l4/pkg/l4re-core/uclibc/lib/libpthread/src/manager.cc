@@ -531,7 +531,8 @@ static inline
 int __pthread_mgr_create_thread(pthread_descr thread, char **tos,
                                 int (*f)(void*), int prio,
                                 unsigned create_flags,
-                                l4_sched_cpu_set_t const &affinity)
+                                l4_sched_cpu_set_t const &affinity,
+                                l4_cap_idx_t sched_constraint)
 {
   using namespace L4Re;
   Env const *e = Env::env();
@@ -562,6 +563,14 @@ int __pthread_mgr_create_thread(pthread_descr thread, char **tos,
   if (err < 0)
     return err;
 
+  if (l4_is_valid_cap(sched_constraint))
+    {
+      err = l4_error(e->scheduler()->attach_sc(_t.get(),
+                       L4::Cap<L4::Sched_constraint>(sched_constraint)));
+      if (err < 0)
+        return err;
+    }
+
   err = __alloc_thread_sem(thread, th_sem.get());
   if (err < 0)
     return err;
@@ -695,7 +704,8 @@ int __pthread_start_manager(pthread_descr mgr)
   mgr->p_tid = claim_unused_utcb();
 
   err = __pthread_mgr_create_thread(mgr, &__pthread_manager_thread_tos,
-                                    __pthread_manager, -1, 0, l4_sched_cpu_set(0, ~0, 1));
+                                    __pthread_manager, -1, 0, l4_sched_cpu_set(0, ~0, 1),
+                                    L4_INVALID_CAP);
   if (err < 0)
     {
       fprintf(stderr, "ERROR: could not start pthread manager thread (err=%d)\n", err);
@@ -854,7 +864,8 @@ static int pthread_handle_create(pthread_descr creator, const pthread_attr_t *at
   err =  __pthread_mgr_create_thread(new_thread, &stack_addr,
                                      pthread_start_thread, prio,
                                      attr ? attr->create_flags : 0,
-                                     attr ? attr->affinity : l4_sched_cpu_set(0, ~0, 1));
+                                     attr ? attr->affinity : l4_sched_cpu_set(0, ~0, 1),
+                                     attr ? attr->sched_constraint : L4_INVALID_CAP);
   saved_errno = -err;
 
   /* Check if cloning succeeded */
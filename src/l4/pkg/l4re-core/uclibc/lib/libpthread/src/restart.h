@@ -20,15 +20,58 @@
 #include <l4/sys/types.h>
 #include <l4/sys/semaphore.h>
 
-/* Primitives for controlling thread execution */
+/* Primitives for controlling thread execution
+
+   Like the signal based __pthread_restart_old/__pthread_suspend_old, these
+   give restart() queuing semantics via p_resume_count: restart() increments
+   the count and only signals the thread semaphore if the target announced
+   that it blocks in the kernel (count was negative).  suspend() first spins
+   for up to __pthread_l4_spin_count iterations, which the first suspend()
+   calibrates against the cost of a semaphore round trip, waiting for a
+   pending restart.  Only then it decrements the count and blocks.  Wakeups
+   that arrive during the spin phase cost no kernel entry on either side. */
+
+static __inline__ int __pthread_l4_spin_limit(pthread_descr self)
+{
+  int c = __atomic_load_n(&__pthread_l4_spin_count, __ATOMIC_RELAXED);
+  if (__builtin_expect(c < 0, 0))
+    {
+      __pthread_l4_calibrate_spin(self);
+      c = __atomic_load_n(&__pthread_l4_spin_count, __ATOMIC_RELAXED);
+    }
+  return c;
+}
+
+static __inline__ int __pthread_l4_try_consume_restart(pthread_descr self)
+{
+  long cnt = __atomic_load_n(&self->p_resume_count.p_count, __ATOMIC_ACQUIRE);
+  return cnt > 0
+         && __atomic_compare_exchange_n(&self->p_resume_count.p_count, &cnt,
+                                        cnt - 1, 0, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED);
+}
 
 static __inline__ void restart(pthread_descr th)
 {
-  l4_semaphore_up(th->p_thsem_cap);
+  if (__atomic_fetch_add(&th->p_resume_count.p_count, 1, __ATOMIC_RELEASE) < 0)
+    l4_semaphore_up(th->p_thsem_cap);
 }
 
 static __inline__ void suspend(pthread_descr self)
 {
+  int i, limit = __pthread_l4_spin_limit(self);
+  for (i = 0; i < limit; i++)
+    {
+      if (__pthread_l4_try_consume_restart(self))
+        return;
+#ifdef BUSY_WAIT_NOP
+      BUSY_WAIT_NOP;
+#endif
+    }
+
+  if (__atomic_fetch_sub(&self->p_resume_count.p_count, 1, __ATOMIC_ACQUIRE) > 0)
+    return;
+
   l4_semaphore_down(self->p_thsem_cap, L4_IPC_NEVER);
 }
 
@@ -36,13 +79,36 @@ static __inline__ int timedsuspend(pthread_descr self,
 		const struct timespec *abstime)
 {
   extern uint64_t __attribute__((weak)) __libc_l4_kclock_offset;
+  int i, limit = __pthread_l4_spin_limit(self);
+  for (i = 0; i < limit; i++)
+    {
+      if (__pthread_l4_try_consume_restart(self))
+        return 1;
+#ifdef BUSY_WAIT_NOP
+      BUSY_WAIT_NOP;
+#endif
+    }
+
+  if (__atomic_fetch_sub(&self->p_resume_count.p_count, 1, __ATOMIC_ACQUIRE) > 0)
+    return 1;
+
   uint64_t clock = abstime->tv_sec * 1000000ULL + abstime->tv_nsec / 1000;
   if (&__libc_l4_kclock_offset)
     clock -= __libc_l4_kclock_offset;
   l4_timeout_t timeout = L4_IPC_NEVER;
   l4_rcv_timeout(l4_timeout_abs_u(clock, 4, l4_utcb()), &timeout);
   l4_msgtag_t res = l4_semaphore_down(self->p_thsem_cap, timeout);
-  if (l4_error(res) == -(L4_EIPC_LO + L4_IPC_RETIMEOUT))
+  if (l4_error(res) != -(L4_EIPC_LO + L4_IPC_RETIMEOUT))
+    return 1;
+
+  /* Timed out: withdraw the announcement that we block.  If a restart()
+     raced with the timeout, it already accounted for us and its semaphore
+     signal is pending, so consume that instead and report the wakeup. */
+  long cnt = -1;
+  if (__atomic_compare_exchange_n(&self->p_resume_count.p_count, &cnt, 0, 0,
+                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
     return 0;
+
+  l4_semaphore_down(self->p_thsem_cap, L4_IPC_NEVER);
   return 1;
 }
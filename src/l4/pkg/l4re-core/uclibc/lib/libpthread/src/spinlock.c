@@ -92,9 +92,11 @@ void internal_function __pthread_lock(struct _pthread_fastlock * lock,
 
   if (__pthread_smp_kernel) {
     int max_count = lock->__spinlock * 2 + 10;
+    int limit = __pthread_l4_spin_count > MAX_ADAPTIVE_SPIN_COUNT
+                ? __pthread_l4_spin_count : MAX_ADAPTIVE_SPIN_COUNT;
 
-    if (max_count > MAX_ADAPTIVE_SPIN_COUNT)
-      max_count = MAX_ADAPTIVE_SPIN_COUNT;
+    if (max_count > limit)
+      max_count = limit;
 
     for (spin_count = 0; spin_count < max_count; spin_count++) {
       if (((oldstatus = lock->__status) & 1) == 0) {
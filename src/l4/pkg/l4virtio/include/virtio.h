@@ -92,8 +92,12 @@ enum L4virtio_device_status
 /** L4virtio-specific feature bits. */
 enum L4virtio_feature_bits
 {
+  /// Notifications are suppressed with event indexes (VIRTIO_F_EVENT_IDX).
+  L4VIRTIO_FEATURE_RING_EVENT_IDX = 29,
   /// Virtio protocol version 1 supported. Must be 1 for L4virtio.
   L4VIRTIO_FEATURE_VERSION_1  = 32,
+  /// Queues use the packed layout (VIRTIO_F_RING_PACKED).
+  L4VIRTIO_FEATURE_RING_PACKED = 34,
   /// Status and queue config are set via cmd field instead of via IPC.
   L4VIRTIO_FEATURE_CMD_CONFIG = 224
 };
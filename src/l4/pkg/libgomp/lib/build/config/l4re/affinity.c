@@ -0,0 +1,358 @@
+/*
+ * L4Re specific implementation of the libgomp CPU affinity interface.
+ *
+ * A place is a bitmap of logical CPUs as numbered by the L4Re scheduler
+ * object (offset 0, granularity 0).  Like the affinity mask kept by
+ * libpthread it is limited to a single machine word.  Team threads are bound
+ * to their place through the L4 specific members of pthread_attr_t, which
+ * the pthread manager passes on to L4::Scheduler::run_thread().
+ *
+ * If GOMP_L4RE_TEAM_SC names a capability in the initial environment, that
+ * scheduling constraint is attached to every thread bound to a place, in
+ * addition to the thread's own constraint.  All bound threads of the
+ * program then share its budget.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+#include "libgomp.h"
+#include "proc.h"
+#include <l4/re/env.h>
+#include <l4/sys/scheduler.h>
+#include <pthread-l4.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+/* Constraint shared by all bound threads, or L4_INVALID_CAP.  */
+static l4_cap_idx_t gomp_l4re_team_sc = L4_INVALID_CAP;
+static bool gomp_l4re_team_sc_parsed;
+
+static void
+gomp_l4re_parse_team_sc (void)
+{
+  if (gomp_l4re_team_sc_parsed)
+    return;
+
+  gomp_l4re_team_sc_parsed = true;
+  const char *name = getenv ("GOMP_L4RE_TEAM_SC");
+  if (name == NULL || *name == '\0')
+    return;
+
+  gomp_l4re_team_sc = l4re_env_get_cap (name);
+  if (l4_is_invalid_cap (gomp_l4re_team_sc))
+    gomp_error ("GOMP_L4RE_TEAM_SC: no capability named '%s'", name);
+}
+
+void
+gomp_init_affinity (void)
+{
+  gomp_l4re_parse_team_sc ();
+
+  if (gomp_places_list == NULL)
+    {
+      if (!gomp_affinity_init_level (1, ULONG_MAX, true))
+	return;
+    }
+
+  struct gomp_thread *thr = gomp_thread ();
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  set.__bits[0] = *(l4_umword_t *) gomp_places_list[0];
+  pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+
+  if (l4_is_valid_cap (gomp_l4re_team_sc))
+    l4_scheduler_attach_sc (l4re_env ()->scheduler,
+			    pthread_l4_cap (pthread_self ()),
+			    gomp_l4re_team_sc);
+
+  thr->place = 1;
+  thr->ts.place_partition_off = 0;
+  thr->ts.place_partition_len = gomp_places_list_len;
+}
+
+void
+gomp_init_thread_affinity (pthread_attr_t *attr, unsigned int place)
+{
+  attr->affinity
+    = l4_sched_cpu_set (0, 0, *(l4_umword_t *) gomp_places_list[place]);
+  attr->sched_constraint = gomp_l4re_team_sc;
+}
+
+void **
+gomp_affinity_alloc (unsigned long count, bool quiet)
+{
+  unsigned long i;
+  void **ret;
+  l4_umword_t *p;
+
+  ret = malloc (count * (sizeof (void *) + sizeof (l4_umword_t)));
+  if (ret == NULL)
+    {
+      if (!quiet)
+	gomp_error ("Out of memory trying to allocate places list");
+      return NULL;
+    }
+
+  p = (l4_umword_t *) (ret + count);
+  for (i = 0; i < count; i++)
+    ret[i] = &p[i];
+  return ret;
+}
+
+void
+gomp_affinity_init_place (void *p)
+{
+  *(l4_umword_t *) p = 0;
+}
+
+bool
+gomp_affinity_add_cpus (void *p, unsigned long num,
+			unsigned long len, long stride, bool quiet)
+{
+  l4_umword_t *place = (l4_umword_t *) p;
+  for (;;)
+    {
+      if (num >= GOMP_L4RE_MAX_CPUS)
+	{
+	  if (!quiet)
+	    gomp_error ("Logical CPU number %lu out of range", num);
+	  return false;
+	}
+      *place |= 1UL << num;
+      if (--len == 0)
+	return true;
+      if ((stride < 0 && num + stride > num)
+	  || (stride > 0 && num + stride < num))
+	{
+	  if (!quiet)
+	    gomp_error ("Logical CPU number %lu+%ld out of range",
+			num, stride);
+	  return false;
+	}
+      num += stride;
+    }
+}
+
+bool
+gomp_affinity_remove_cpu (void *p, unsigned long num)
+{
+  l4_umword_t *place = (l4_umword_t *) p;
+  if (num >= GOMP_L4RE_MAX_CPUS)
+    {
+      gomp_error ("Logical CPU number %lu out of range", num);
+      return false;
+    }
+  if (!(*place & (1UL << num)))
+    {
+      gomp_error ("Logical CPU %lu to be removed is not in the set", num);
+      return false;
+    }
+  *place &= ~(1UL << num);
+  return true;
+}
+
+bool
+gomp_affinity_copy_place (void *p, void *q, long stride)
+{
+  unsigned long i;
+  l4_umword_t src = *(l4_umword_t *) q;
+  l4_umword_t dst = 0;
+
+  for (i = 0; i < GOMP_L4RE_MAX_CPUS; i++)
+    if (src & (1UL << i))
+      {
+	if ((stride < 0 && i + stride > i)
+	    || (stride > 0 && (i + stride < i
+			       || i + stride >= GOMP_L4RE_MAX_CPUS)))
+	  {
+	    gomp_error ("Logical CPU number %lu+%ld out of range", i, stride);
+	    return false;
+	  }
+	dst |= 1UL << (i + stride);
+      }
+  *(l4_umword_t *) p = dst;
+  return true;
+}
+
+bool
+gomp_affinity_same_place (void *p, void *q)
+{
+  return *(l4_umword_t *) p == *(l4_umword_t *) q;
+}
+
+bool
+gomp_affinity_finalize_place_list (bool quiet)
+{
+  unsigned long i, j;
+  l4_umword_t online = gomp_l4re_online_cpus ();
+
+  for (i = 0, j = 0; i < gomp_places_list_len; i++)
+    {
+      l4_umword_t *place = (l4_umword_t *) gomp_places_list[i];
+      *place &= online;
+      if (*place != 0)
+	gomp_places_list[j++] = gomp_places_list[i];
+    }
+
+  if (j == 0)
+    {
+      if (!quiet)
+	gomp_error ("None of the places contain usable logical CPUs");
+      return false;
+    }
+  else if (j < gomp_places_list_len)
+    {
+      if (!quiet)
+	gomp_error ("Number of places reduced from %ld to %ld because some "
+		    "places didn't contain any usable logical CPUs",
+		    gomp_places_list_len, j);
+      gomp_places_list_len = j;
+    }
+  return true;
+}
+
+/* L4Re does not expose the CPU topology, so threads and cores both map to
+   one place per online CPU while sockets map to a single place containing
+   all online CPUs.  */
+bool
+gomp_affinity_init_level (int level, unsigned long count, bool quiet)
+{
+  unsigned long i;
+  l4_umword_t online = gomp_l4re_online_cpus ();
+  unsigned long ncpus = __builtin_popcountl (online);
+
+  if (level == 3)
+    ncpus = 1;
+  if (count > ncpus)
+    count = ncpus;
+
+  gomp_places_list = gomp_affinity_alloc (count, quiet);
+  gomp_places_list_len = 0;
+  if (gomp_places_list == NULL)
+    return false;
+
+  if (level == 3)
+    {
+      *(l4_umword_t *) gomp_places_list[0] = online;
+      gomp_places_list_len = 1;
+      return true;
+    }
+
+  for (i = 0; i < GOMP_L4RE_MAX_CPUS && gomp_places_list_len < count; i++)
+    if (online & (1UL << i))
+      *(l4_umword_t *) gomp_places_list[gomp_places_list_len++] = 1UL << i;
+
+  return true;
+}
+
+void
+gomp_affinity_print_place (void *p)
+{
+  unsigned long i, len;
+  l4_umword_t place = *(l4_umword_t *) p;
+  bool notfirst = false;
+
+  for (i = 0, len = 0; i < GOMP_L4RE_MAX_CPUS; i++)
+    if (place & (1UL << i))
+      {
+	if (len == 0)
+	  {
+	    if (notfirst)
+	      fputc (',', stderr);
+	    notfirst = true;
+	    fprintf (stderr, "%lu", i);
+	  }
+	++len;
+      }
+    else
+      {
+	if (len > 1)
+	  fprintf (stderr, ":%lu", len);
+	len = 0;
+      }
+  if (len > 1)
+    fprintf (stderr, ":%lu", len);
+}
+
+int
+omp_get_place_num_procs (int place_num)
+{
+  if (place_num < 0 || place_num >= gomp_places_list_len)
+    return 0;
+
+  return __builtin_popcountl (*(l4_umword_t *) gomp_places_list[place_num]);
+}
+
+void
+omp_get_place_proc_ids (int place_num, int *ids)
+{
+  if (place_num < 0 || place_num >= gomp_places_list_len)
+    return;
+
+  l4_umword_t place = *(l4_umword_t *) gomp_places_list[place_num];
+  unsigned long i;
+  for (i = 0; i < GOMP_L4RE_MAX_CPUS; i++)
+    if (place & (1UL << i))
+      *ids++ = i;
+}
+
+void
+gomp_get_place_proc_ids_8 (int place_num, int64_t *ids)
+{
+  if (place_num < 0 || place_num >= gomp_places_list_len)
+    return;
+
+  l4_umword_t place = *(l4_umword_t *) gomp_places_list[place_num];
+  unsigned long i;
+  for (i = 0; i < GOMP_L4RE_MAX_CPUS; i++)
+    if (place & (1UL << i))
+      *ids++ = i;
+}
+
+void
+gomp_display_affinity_place (char *buffer, size_t size, size_t *ret,
+			     int place)
+{
+  l4_umword_t set;
+  char buf[sizeof (long) * 3 + 4];
+  if (place >= 0 && place < gomp_places_list_len)
+    set = *(l4_umword_t *) gomp_places_list[place];
+  else
+    set = gomp_l4re_online_cpus ();
+
+  unsigned long i, max = GOMP_L4RE_MAX_CPUS, start;
+  bool prev_set = false;
+  start = max;
+  for (i = 0; i <= max; i++)
+    {
+      bool this_set;
+      if (i == max)
+	this_set = false;
+      else
+	this_set = (set & (1UL << i)) != 0;
+      if (this_set != prev_set)
+	{
+	  prev_set = this_set;
+	  if (this_set)
+	    {
+	      char *p = buf;
+	      if (start != max)
+		*p++ = ',';
+	      sprintf (p, "%lu", i);
+	      start = i;
+	    }
+	  else if (i == start + 1)
+	    continue;
+	  else
+	    sprintf (buf, "-%lu", i - 1);
+	  gomp_display_string (buffer, size, ret, buf, strlen (buf));
+	}
+    }
+}
+
+ialias(omp_get_place_num_procs)
+ialias(omp_get_place_proc_ids)
@@ -0,0 +1,58 @@
+/*
+ * L4Re specific routines related to counting online processors.
+ *
+ * The generic POSIX version relies on sysconf(_SC_NPROCESSORS_ONLN), which
+ * the L4Re libc backend does not answer truthfully.  Ask the scheduler
+ * object of the initial environment instead.
+ */
+
+#include "libgomp.h"
+#include "proc.h"
+#include <l4/re/env.h>
+#include <l4/sys/scheduler.h>
+
+static l4_umword_t gomp_l4re_online;
+
+l4_umword_t
+gomp_l4re_online_cpus (void)
+{
+  if (gomp_l4re_online == 0)
+    {
+      l4_sched_cpu_set_t cpus = l4_sched_cpu_set (0, 0, 0);
+      if (l4_error (l4_scheduler_info (l4re_env ()->scheduler, NULL, &cpus))
+	  < 0 || cpus.map == 0)
+	cpus.map = 1;
+      gomp_l4re_online = cpus.map;
+    }
+  return gomp_l4re_online;
+}
+
+/* At startup, determine the default number of threads.  */
+
+void
+gomp_init_num_threads (void)
+{
+  gomp_global_icv.nthreads_var
+    = __builtin_popcountl (gomp_l4re_online_cpus ());
+}
+
+/* When OMP_DYNAMIC is set, at thread launch determine the number of
+   threads we should spawn for this team.  There is no load average on
+   L4Re, so just use the number of online CPUs.  */
+
+unsigned
+gomp_dynamic_max_threads (void)
+{
+  unsigned n_onln = __builtin_popcountl (gomp_l4re_online_cpus ());
+  unsigned nthreads_var = gomp_icv (false)->nthreads_var;
+
+  return n_onln > nthreads_var ? nthreads_var : n_onln;
+}
+
+int
+omp_get_num_procs (void)
+{
+  return __builtin_popcountl (gomp_l4re_online_cpus ());
+}
+
+ialias (omp_get_num_procs)
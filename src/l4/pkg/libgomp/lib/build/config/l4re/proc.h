@@ -0,0 +1,16 @@
+/*
+ * L4Re specific processor queries shared by proc.c and affinity.c.
+ */
+
+#ifndef GOMP_PROC_H
+#define GOMP_PROC_H 1
+
+#include <l4/sys/l4int.h>
+
+/* Largest number of CPUs a place can describe.  */
+#define GOMP_L4RE_MAX_CPUS (sizeof (l4_umword_t) * 8)
+
+/* Bitmap of CPUs the scheduler reports online.  */
+extern l4_umword_t gomp_l4re_online_cpus (void) attribute_hidden;
+
+#endif /* GOMP_PROC_H */
@@ -13,7 +13,6 @@
 
 #include <l4/shmc/shmc.h>
 #include <l4/util/assert.h>
-#include <l4/sys/thread.h>
 
 __BEGIN_DECLS
 
@@ -30,6 +29,13 @@ __BEGIN_DECLS
  * side, because allocation of the SHM chunk and the necessary signals is done
  * on the sender side and the receiver initialization tries to attach to these
  * objects.
+ *
+ * The buffer is a single-producer/single-consumer queue: the sender only
+ * writes the write offset and the receiver only writes the read offset, each
+ * in its own cache line, and packets are published with release/acquire
+ * ordering. There is no lock. The receiver signal is only triggered when a
+ * committed packet makes the buffer non-empty, so a receiver must consume
+ * all packets before waiting again.
  */
 
 /**
@@ -44,11 +50,21 @@ __BEGIN_DECLS
  */
 
 /*
- * Turn on ringbuf poisoning. This will add magic values to the ringbuf
- * header as well as each packet header and check that these values are
- * valid all the time.
+ * Ringbuf poisoning adds magic values to the ringbuf header as well as each
+ * packet header and checks that these values are valid all the time. It is
+ * meant for debug builds, define L4SHMC_RINGBUF_POISONING to 1 for both
+ * sides to enable it.
+ */
+#ifndef L4SHMC_RINGBUF_POISONING
+#define L4SHMC_RINGBUF_POISONING 0
+#endif
+
+/**
+ * Cache line size the fields written by sender and receiver are separated by.
+ *
+ * \ingroup l4shmc_ringbuf_internal
  */
-#define L4SHMC_RINGBUF_POISONING 1
+#define L4SHMC_RINGBUF_CACHELINE 64
 
 /**
  * Head field of a ring buffer.
@@ -57,22 +73,25 @@ __BEGIN_DECLS
  */
 typedef struct
 {
-  volatile l4_uint32_t lock;
   unsigned data_size;
 #if L4SHMC_RINGBUF_POISONING
   char     magic1;
-#endif
-  unsigned next_read;    ///< offset to next read packet
-  unsigned next_write;   ///< offset to next write packet
-#if L4SHMC_RINGBUF_POISONING
   char     magic2;
-#endif
-  unsigned bytes_filled; ///< bytes filled in buffer
-  unsigned sender_waits; ///< sender waiting?
-#if L4SHMC_RINGBUF_POISONING
   char     magic3;
 #endif
-  char data[];           ///< tail pointer -> data
+
+  /// Offset behind the last committed packet, written by the sender.
+  unsigned next_write __attribute__((aligned(L4SHMC_RINGBUF_CACHELINE)));
+  /// Offset behind the last allocated packet, private to the sender.
+  unsigned alloc_write;
+
+  /// Offset to the next packet to read, written by the receiver.
+  unsigned next_read __attribute__((aligned(L4SHMC_RINGBUF_CACHELINE)));
+
+  /// Sender waits for space, set by the sender, cleared by the receiver.
+  unsigned sender_waits __attribute__((aligned(L4SHMC_RINGBUF_CACHELINE)));
+
+  char data[] __attribute__((aligned(L4SHMC_RINGBUF_CACHELINE))); ///< tail pointer -> data
 } l4shmc_ringbuf_head_t;
 
 
@@ -119,35 +138,7 @@ typedef struct
  *
  * \ingroup l4shmc_ringbuf_internal
  */
-#define L4SHMC_RINGBUF_DATA_SIZE(ringbuf)  ((ringbuf)->_size - sizeof(l4shmc_ringbuf_head_t))
-
-enum lock_content
-{
-  lock_cont_min = 4,
-  locked        = 5,
-  unlocked      = 6,
-  lock_cont_max = 7,
-};
-
-static L4_CV inline void l4shmc_rb_lock(l4shmc_ringbuf_head_t *head)
-{
-  ASSERT_NOT_NULL(head);
-  ASSERT_ASSERT(head->lock > lock_cont_min);
-  ASSERT_ASSERT(head->lock < lock_cont_max);
-
-  while (!l4util_cmpxchg32(&head->lock, unlocked, locked))
-    l4_thread_yield();
-}
-
-
-static L4_CV inline void l4shmc_rb_unlock(l4shmc_ringbuf_head_t *head)
-{
-  ASSERT_NOT_NULL(head);
-  ASSERT_ASSERT(head->lock > lock_cont_min);
-  ASSERT_ASSERT(head->lock < lock_cont_max);
-
-  head->lock = unlocked;
-}
+#define L4SHMC_RINGBUF_DATA_SIZE(ringbuf)  (L4SHMC_RINGBUF_HEAD(ringbuf)->data_size)
 
 /******************
  * Initialization *
@@ -257,6 +248,9 @@ L4_CV int  l4shmc_rb_sender_next_copy_in(l4shmc_ringbuf_t *buf, char *data,
 /**
  * Tell the consumer that new data is available.
  *
+ * Makes all packets allocated since the last commit visible to the
+ * consumer. The consumer is only notified if the buffer was empty before.
+ *
  * \param buf           pointer to ring buffer struct
  */
 L4_CV void l4shmc_rb_sender_commit_packet(l4shmc_ringbuf_t *buf);
@@ -67,15 +67,59 @@ typedef struct
 static void log_ringbuf_head(l4shmc_ringbuf_head_t *head)
 {
   ASSERT_NOT_NULL(head);
-  printf("   head @ %p, lock state '%s', data size %d\n", head,
-         head->lock == locked ? "LOCKED" : "unlocked",
-         head->data_size);
-  printf("   next_rd %x next_wr %x filled %d, data @ %p\n",
-         head->next_read, head->next_write, head->bytes_filled,
+  printf("   head @ %p, data size %d, sender waits %d\n", head,
+         head->data_size, head->sender_waits);
+  printf("   next_rd %x next_wr %x alloc_wr %x, data @ %p\n",
+         head->next_read, head->next_write, head->alloc_write,
          head->data);
 }
 
 
+/*
+ * The ring buffer head is aligned to a cache line within the chunk, so that
+ * the offsets written by sender and receiver really end up in different
+ * cache lines. Chunks are at the same offset within the page-aligned area on
+ * both sides, so both sides find the head at the same offset.
+ */
+static l4shmc_ringbuf_head_t *l4shmc_rb_head_ptr(l4shmc_chunk_t *chunk)
+{
+  l4_addr_t a = (l4_addr_t)l4shmc_chunk_ptr(chunk);
+  a = (a + L4SHMC_RINGBUF_CACHELINE - 1) & ~(l4_addr_t)(L4SHMC_RINGBUF_CACHELINE - 1);
+  return (l4shmc_ringbuf_head_t *)a;
+}
+
+
+/*
+ * Advance an offset behind a packet of `psize` bytes including the size
+ * cookie. If there is no space for another size cookie at the end of the
+ * buffer, the next packet starts at the beginning. Sender and receiver use
+ * this to agree on packet boundaries.
+ */
+static unsigned l4shmc_rb_advance(l4shmc_ringbuf_head_t *head, unsigned offs,
+                                  unsigned psize)
+{
+  offs += psize;
+  // wrap around?
+  if (offs >= head->data_size)
+    offs %= head->data_size;
+  // space does not fit another size cookie - step to beginning
+  if (offs + sizeof(size_cookie_t) >= head->data_size)
+    offs = 0;
+  return offs;
+}
+
+
+/*
+ * Bytes used between the read offset R and the write offset W. W == R means
+ * empty, the sender never fills the buffer completely.
+ */
+static unsigned l4shmc_rb_used(l4shmc_ringbuf_head_t *head, unsigned W,
+                               unsigned R)
+{
+  return W >= R ? W - R : head->data_size - R + W;
+}
+
+
 static void log_ringbuf(l4shmc_ringbuf_t *buf)
 {
   ASSERT_NOT_NULL(buf);
@@ -147,10 +191,9 @@ void l4shmc_rb_init_header(l4shmc_ringbuf_head_t *head);
 {
   ASSERT_NOT_NULL(head);
 
-  head->lock         = unlocked;
   head->next_read    = 0;
   head->next_write   = 0;
-  head->bytes_filled = 0;
+  head->alloc_write  = 0;
   head->sender_waits = 0;
 #if L4SHMC_RINGBUF_POISONING
   head->magic1 = BUF_HEAD_MAGIC1;
@@ -175,7 +218,7 @@ L4_CV int l4shmc_rb_init_receiver(l4shmc_ringbuf_t *buf, l4shmc_area_t *area,
 
   buf->_size = l4shmc_chunk_capacity(&buf->_chunk);
   printf("RCV: buf size %d\n", buf->_size);
-  buf->_addr = l4shmc_chunk_ptr(&buf->_chunk);
+  buf->_addr = l4shmc_rb_head_ptr(&buf->_chunk);
 
   log_ringbuf(buf);
   return 0;
@@ -217,8 +260,23 @@ L4_CV int l4shmc_rb_receiver_wait_for_data(l4shmc_ringbuf_t *buf, int block)
   else
     to = L4_IPC_BOTH_TIMEOUT_0;
 
-  //while (!L4SHMC_RINGBUF_HEAD(buf)->bytes_filled)
-  return l4shmc_wait_signal_to(&buf->_signal_empty, to);
+  l4shmc_ringbuf_head_t *head = L4SHMC_RINGBUF_HEAD(buf);
+
+  // The sender only triggers the signal when the buffer becomes non-empty,
+  // so look at the buffer first. The fence pairs with the one in
+  // l4shmc_rb_sender_commit_packet(): either we see the new write offset or
+  // the sender sees our read offset and triggers the signal.
+  for (;;)
+    {
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&head->next_write, __ATOMIC_ACQUIRE)
+          != head->next_read)
+        return 0;
+
+      int err = l4shmc_wait_signal_to(&buf->_signal_empty, to);
+      if (err)
+        return err;
+    }
 }
 
 
@@ -229,18 +287,16 @@ L4_CV int l4shmc_rb_receiver_copy_out(l4shmc_ringbuf_head_t *head,
   ASSERT_NOT_NULL(target);
   ASSERT_NOT_NULL(tsize);
 
-  l4shmc_rb_lock(head);
+  unsigned R = head->next_read;
+  unsigned W = __atomic_load_n(&head->next_write, __ATOMIC_ACQUIRE);
 
   // users (e.g., L4Lx) may call this function directly w/o
   // checking whether data is available. In this case, simply
   // return an error here.
-  if (head->bytes_filled == 0)
-    {
-      l4shmc_rb_unlock(head);
-      return -L4_ENOENT;
-    }
+  if (R == W)
+    return -L4_ENOENT;
 
-  char *addr     = head->data + head->next_read;
+  char *addr     = head->data + R;
   char *max_addr = head->data + head->data_size;
 
   unsigned size_in_buffer = EXTRACT_SIZE(addr);
@@ -268,18 +324,10 @@ L4_CV int l4shmc_rb_receiver_copy_out(l4shmc_ringbuf_head_t *head,
   else
     memcpy(target, addr, *tsize);
 
-  head->next_read += (*tsize + sizeof(size_cookie_t));
-  // wrap around?
-  if (head->next_read >= head->data_size)
-    head->next_read %= head->data_size;
-  // if there's no space for a length field, the sender will
-  // have wrapped until beginning of buffer already
-  if (head->next_read + sizeof(size_cookie_t) >= head->data_size)
-    head->next_read = 0;
-  head->bytes_filled -= (*tsize + sizeof(size_cookie_t));
-  ASSERT_GREATER_EQ(head->data_size, head->bytes_filled);
-
-  l4shmc_rb_unlock(head);
+  // release the packet space to the sender only after copying it out
+  __atomic_store_n(&head->next_read,
+                   l4shmc_rb_advance(head, R, *tsize + sizeof(size_cookie_t)),
+                   __ATOMIC_RELEASE);
 
   return 0;
 }
@@ -289,19 +337,20 @@ L4_CV void l4shmc_rb_receiver_notify_done(l4shmc_ringbuf_t *buf)
 {
   ASSERT_NOT_NULL(buf);
 
-  l4shmc_rb_lock(L4SHMC_RINGBUF_HEAD(buf));
+  l4shmc_ringbuf_head_t *head = L4SHMC_RINGBUF_HEAD(buf);
 
-  if (L4SHMC_RINGBUF_HEAD(buf)->sender_waits)
+  // Pairs with the fence in l4shmc_rb_sender_alloc_packet(): either the
+  // sender sees our new read offset or we see its wait flag.
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&head->sender_waits, __ATOMIC_RELAXED))
     {
-      L4SHMC_RINGBUF_HEAD(buf)->sender_waits = 0;
+      __atomic_store_n(&head->sender_waits, 0, __ATOMIC_RELAXED);
 #if 0
       printf("RCV: TRIGGER %lx (%lx)\n", buf->_signal_empty._sigcap,
              l4_debugger_global_id(buf->_signal_empty._sigcap));
 #endif
       l4shmc_trigger(&buf->_signal_full);
     }
-
-  l4shmc_rb_unlock(L4SHMC_RINGBUF_HEAD(buf));
 }
 
 
@@ -311,14 +360,13 @@ L4_CV int l4shmc_rb_receiver_read_next_size(l4shmc_ringbuf_head_t *head)
 
   int ret = -1;
 
-  l4shmc_rb_lock(head);
-  if (head->bytes_filled > 0)
+  unsigned R = head->next_read;
+  if (__atomic_load_n(&head->next_write, __ATOMIC_ACQUIRE) != R)
     {
-      char *addr = head->data + head->next_read;
+      char *addr = head->data + R;
       ASSERT_COOKIE(addr);
       ret = EXTRACT_SIZE(addr);
     }
-  l4shmc_rb_unlock(head);
 
   return ret;
 }
@@ -364,7 +412,8 @@ L4_CV int l4shmc_rb_init_buffer(l4shmc_ringbuf_t *buf, l4shmc_area_t *area,
   l4shmc_rb_generic_init(area, chunk_name, buf);
   l4shmc_rb_generic_signal_init(buf, signal_name);
 
-  buf->_size = size + sizeof(l4shmc_ringbuf_head_t);
+  // leave room to align the head to a cache line
+  buf->_size = size + sizeof(l4shmc_ringbuf_head_t) + L4SHMC_RINGBUF_CACHELINE;
   printf("add_chunk: area %p, name '%s', size %d\n", buf->_area,
          buf->_chunkname, buf->_size);
   err = l4shmc_add_chunk(buf->_area, buf->_chunkname, buf->_size, &buf->_chunk);
@@ -372,7 +421,7 @@ L4_CV int l4shmc_rb_init_buffer(l4shmc_ringbuf_t *buf, l4shmc_area_t *area,
 
   l4shmc_rb_sender_add_signals(buf, signal_name);
 
-  buf->_addr = l4shmc_chunk_ptr(&buf->_chunk);
+  buf->_addr = l4shmc_rb_head_ptr(&buf->_chunk);
 
   l4shmc_rb_init_header(L4SHMC_RINGBUF_HEAD(buf));
   L4SHMC_RINGBUF_HEAD(buf)->data_size = size;
@@ -419,44 +468,36 @@ L4_CV char *l4shmc_rb_sender_alloc_packet(l4shmc_ringbuf_head_t *head, unsigned
 {
   ASSERT_NOT_NULL(head);
 
-  char *ret = NULL;
-  int psize = size + sizeof(size_cookie_t); // need space to store packet size
+  unsigned psize = size + sizeof(size_cookie_t); // need space to store packet size
 
-  l4shmc_rb_lock(head);
+  // a packet never fits, not even into an empty buffer
+  if (psize + sizeof(size_cookie_t) >= head->data_size)
+    return NULL;
 
-  unsigned W = head->next_write;
-  unsigned B = head->bytes_filled;
+  unsigned W = head->alloc_write;
+  unsigned next = l4shmc_rb_advance(head, W, psize);
+  // space consumed by the packet, including a skipped end of the buffer
+  unsigned need = l4shmc_rb_used(head, next, W);
 
-  int diff = head->data_size - B;
-  ASSERT_GREATER_EQ(diff, 0);
-  while (diff < psize)
+  unsigned R = __atomic_load_n(&head->next_read, __ATOMIC_ACQUIRE);
+  if (need >= head->data_size - l4shmc_rb_used(head, W, R))
     {
-      head->sender_waits = 1;
-      goto out;
+      // Tell the receiver to notify us and look again, in case it consumed
+      // everything before seeing the flag.
+      __atomic_store_n(&head->sender_waits, 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      R = __atomic_load_n(&head->next_read, __ATOMIC_ACQUIRE);
+      if (need >= head->data_size - l4shmc_rb_used(head, W, R))
+        return NULL;
     }
 
   // calculate pointer from offset and store packet len
-  ret = head->data + W;
-  *(size_cookie_t*)ret = SIZE_COOKIE_INITIALIZER(psize - sizeof(size_cookie_t));
+  char *ret = head->data + W;
+  *(size_cookie_t*)ret = SIZE_COOKIE_INITIALIZER(size);
   ret += sizeof(size_cookie_t);
 
-  // make sure that there is at least enough space left at the end of
-  // the ring so that we can store a whole packet length field
-  // (sizeof(long))
-  W += psize;
-  // already larger
-  if (W >= head->data_size)
-    W %= head->data_size;
-  // space does not fit another length field - step to beginning
-  if (W + sizeof(size_cookie_t) >= head->data_size)
-    W = 0;
-
-  head->next_write = W;
-  head->bytes_filled += psize;
-  ASSERT_GREATER_EQ(head->data_size, head->bytes_filled);
-
-out:
-  l4shmc_rb_unlock(head);
+  // the packet becomes visible to the receiver on commit
+  head->alloc_write = next;
 
   return ret;
 }
@@ -528,6 +569,20 @@ L4_CV void l4shmc_rb_sender_put_data(l4shmc_ringbuf_t *buf, char *addr, char *da
 L4_CV void l4shmc_rb_sender_commit_packet(l4shmc_ringbuf_t *buf)
 {
   ASSERT_NOT_NULL(buf);
+
+  l4shmc_ringbuf_head_t *head = L4SHMC_RINGBUF_HEAD(buf);
+  unsigned W = head->next_write;
+  if (W == head->alloc_write)
+    return;
+
+  // Publish all packets allocated since the last commit at once. The
+  // receiver only needs a notification if it may have seen an empty buffer,
+  // i.e. if it had consumed everything up to the old write offset.
+  __atomic_store_n(&head->next_write, head->alloc_write, __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&head->next_read, __ATOMIC_RELAXED) != W)
+    return;
+
 #if 0
   printf("SND: TRIGGER %lx (%lx)\n", buf->_signal_empty._sigcap,
          l4_debugger_global_id(buf->_signal_empty._sigcap));
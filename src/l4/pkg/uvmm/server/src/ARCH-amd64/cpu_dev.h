@@ -7,6 +7,8 @@
 
 #include "debug.h"
 #include "generic_cpu_dev.h"
+#include "kvm_steal_time.h"
+#include "steal_time.h"
 #include "vcpu_ptr.h"
 #include "monitor/cpu_dev_cmd_handler.h"
 
@@ -26,8 +28,8 @@ public:
     Running
   };
 
-  Cpu_dev(unsigned idx, unsigned phys_id, Vdev::Dt_node const *)
-  : Generic_cpu_dev(idx, phys_id)
+  Cpu_dev(unsigned idx, unsigned phys_id, Vdev::Dt_node const *node)
+  : Generic_cpu_dev(idx, phys_id, node)
   {
     _cpu_state = (idx == 0) ? Running : Sleeping;
   }
@@ -66,9 +68,24 @@ public:
   void set_protected_mode()
   { _protected_mode = true; }
 
+  /**
+   * Register the guest's steal time area for this vCPU.
+   *
+   * \param st  Host address of the area, nullptr to disable reporting.
+   */
+  void enable_steal_time(Kvm_steal_time *st)
+  { _steal_time.enable(st, thread_cap()); }
+
+  /**
+   * Refresh the guest's steal time area. Call from the vCPU thread.
+   */
+  void update_steal_time()
+  { _steal_time.update(thread_cap()); }
+
 private:
   Cpu_state _cpu_state;
   bool _protected_mode = false;
+  Steal_time<Kvm_steal_time> _steal_time;
 
 }; // class Cpu_dev
 
@@ -175,7 +175,7 @@ Guest::prepare_platform(Vdev::Device_lookup *devs)
       _apics->get(vcpu_id)->attach_cpu_thread(cpu->thread_cap());
 
       auto phys_cpu_id = cpu->get_phys_cpu_id();
-      _clocks[id].start_timer_thread(id, phys_cpu_id);
+      _clocks[id].start_timer_thread(id, phys_cpu_id, &cpu->sched());
     }
 
   register_msr_device(Vdev::make_device<Vcpu_msr_handler>(_cpus.get()));
@@ -566,6 +566,7 @@ Guest::run_vm_t(Vcpu_ptr vcpu, VMS *vm)
     {
       // We do not save/restore the AVX state in the assumption that gcc does
       // not generate such code (yet).
+      cpu->update_steal_time();
       fxrstor64(fpu_state);
       l4_msgtag_t tag = myself->vcpu_resume_commit(myself->vcpu_resume_start());
       fxsave64(fpu_state);
@@ -16,7 +16,8 @@ struct F : Vdev::Factory
                                     Vdev::Dt_node const &) override
   {
     auto dev = Vdev::make_device<Vdev::Kvm_clock_ctrl>(devs->ram(),
-                                                       devs->vmm());
+                                                       devs->vmm(),
+                                                       devs->cpus());
 
     devs->vmm()->register_msr_device(dev);
     devs->vmm()->register_cpuid_device(dev);
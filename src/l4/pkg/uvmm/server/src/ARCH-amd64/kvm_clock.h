@@ -18,6 +18,7 @@
 #include "vm_ram.h"
 #include "ds_mmio_mapper.h"
 #include "cpu_dev.h"
+#include "cpu_dev_array.h"
 #include "guest.h"
 
 namespace Vdev {
@@ -95,10 +96,12 @@ class Kvm_clock_ctrl : public Vmm::Msr_device,
 
 public:
   Kvm_clock_ctrl(cxx::Ref_ptr<Vmm::Vm_ram> const &memmap,
-                 Vmm::Guest *vmm)
+                 Vmm::Guest *vmm,
+                 cxx::Ref_ptr<Vmm::Cpu_dev_array> const &cpus)
   : _boottime(l4_rdtsc()),
     _memmap(memmap),
-    _vmm(vmm)
+    _vmm(vmm),
+    _cpus(cpus)
   {}
 
   bool read_msr(unsigned, l4_uint64_t *, unsigned) const override
@@ -134,14 +137,26 @@ public:
           break;
         }
 
+      case Msr_kvm_steal_time:
+        {
+          trace().printf("Msr_kvm_steal_time to addr 0x%llx\n", addr);
+
+          bool enable = addr & 1;
+
+          // address must be 64-byte aligned
+          auto gaddr = Vmm::Guest_addr(addr & (-1UL << 6));
+          setup_steal_time(enable
+                             ? static_cast<Vmm::Kvm_steal_time *>(host_addr(gaddr))
+                             : nullptr,
+                           core_no);
+          break;
+        }
+
       // NOTE: below functions are disabled via CPUID leaf 0x4000'0001 and
       // shouldn't be invoked by a guest.
       case Msr_kvm_async_pf_en:
         warn().printf("KVM async pf not implemented.\n");
         break;
-      case Msr_kvm_steal_time:
-        warn().printf("KVM steal time not implemented.\n");
-        break;
       case Msr_kvm_eoi_en:
         warn().printf("KVM EIO not implemented.\n");
         break;
@@ -165,6 +180,7 @@ public:
     {
       Kvm_feature_clocksource = 1UL,       // clock at msr 0x11 & 0x12
       Kvm_feature_clocksource2 = 1UL << 3, // clock at msrs 0x4b564d00 & 01;
+      Kvm_feature_steal_time = 1UL << 5,   // steal time at msr 0x4b564d03
     };
 
     switch (regs->ax)
@@ -176,7 +192,7 @@ public:
           *d = 0x4d;       // "M\0\0\0"
           return true;
         case 0x40000001:
-          *a = Kvm_feature_clocksource2;
+          *a = Kvm_feature_clocksource2 | Kvm_feature_steal_time;
           *d = 0;
           *b = *c = 0;
           return true;
@@ -214,6 +230,15 @@ private:
       }
   }
 
+  void setup_steal_time(Vmm::Kvm_steal_time *st, unsigned core_no)
+  {
+    trace().printf("set steal time address: %p on core %u\n", st, core_no);
+
+    assert(core_no < Max_cpus);
+
+    _cpus->cpu(core_no)->enable_steal_time(st);
+  }
+
   void *host_addr(Vmm::Guest_addr addr) const
   {
     return _memmap->guest2host<void *>(addr);
@@ -226,6 +251,7 @@ private:
   cxx::Ref_ptr<Kvm_clock> _clocks[Max_cpus];
   cxx::Ref_ptr<Vmm::Vm_ram> _memmap;
   Vmm::Guest *_vmm;
+  cxx::Ref_ptr<Vmm::Cpu_dev_array> _cpus;
 };
 
 } // namespace
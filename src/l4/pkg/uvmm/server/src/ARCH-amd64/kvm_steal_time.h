@@ -0,0 +1,52 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+#include <l4/cxx/utils>
+#include <l4/l4virtio/virtqueue>
+#include <l4/sys/l4int.h>
+
+namespace Vmm {
+
+/**
+ * Layout of the KVM paravirtual steal time area of a vCPU.
+ */
+struct Kvm_steal_time
+{
+  l4_uint64_t steal;
+  l4_uint32_t version;
+  l4_uint32_t flags;
+  l4_uint8_t  preempted;
+  l4_uint8_t  pad0[3];
+  l4_uint32_t pad[11];
+
+  void reset()
+  {
+    steal = 0;
+    flags = 0;
+    preempted = 0;
+    cxx::write_now(&version, 0U);
+  }
+
+  /**
+   * Store the steal time in nanoseconds.
+   *
+   * The guest retries its read while `version` is odd or changed, so the
+   * payload must become visible strictly between the two version updates.
+   */
+  void publish(l4_uint64_t ns)
+  {
+    cxx::write_now(&version, version + 1);
+    L4virtio::wmb();
+    cxx::write_now(&steal, ns);
+    L4virtio::wmb();
+    cxx::write_now(&version, version + 1);
+  }
+};
+static_assert(sizeof(Kvm_steal_time) == 64,
+              "Kvm_steal_time structure is compact.");
+
+} // namespace
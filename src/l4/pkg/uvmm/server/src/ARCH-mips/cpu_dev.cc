@@ -38,7 +38,7 @@ get_proc_type(char const *compatible)
 }
 
 Cpu_dev::Cpu_dev(unsigned idx, unsigned phys_id, Vdev::Dt_node const *node)
-: Generic_cpu_dev(idx, phys_id), _status(0), _core_other(0)
+: Generic_cpu_dev(idx, phys_id, node), _status(0), _core_other(0)
 {
   // If a compatible property exists, it may be used to specify
   // the reported CPU type (if supported by architecture). Without
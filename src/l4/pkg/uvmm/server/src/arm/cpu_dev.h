@@ -13,6 +13,8 @@
 
 #include "generic_cpu_dev.h"
 #include "monitor/cpu_dev_cmd_handler.h"
+#include "pv_time.h"
+#include "steal_time.h"
 
 extern __thread unsigned vmm_current_cpu_id;
 
@@ -193,6 +195,20 @@ public:
   l4_uint32_t affinity() const
   { return _dt_affinity; }
 
+  /**
+   * Register the guest's stolen time structure for this vCPU.
+   *
+   * \param st  Host address of the structure, nullptr to disable reporting.
+   */
+  void enable_steal_time(Pv_time_stolen *st)
+  { _steal_time.enable(st, thread_cap()); }
+
+  /**
+   * Refresh the guest's stolen time structure. Call from the vCPU thread.
+   */
+  void update_steal_time()
+  { _steal_time.update(thread_cap()); }
+
 private:
   enum
   {
@@ -207,6 +223,7 @@ private:
   l4_umword_t _dt_affinity;
   l4_umword_t _dt_vpidr = 0;
   std::atomic<Cpu_state> _online{Cpu_state::Off};
+  Steal_time<Pv_time_stolen> _steal_time;
 };
 
 }
@@ -18,7 +18,7 @@
 namespace Vmm {
 
 Cpu_dev::Cpu_dev(unsigned idx, unsigned phys_id, Vdev::Dt_node const *node)
-: Generic_cpu_dev(idx, phys_id)
+: Generic_cpu_dev(idx, phys_id, node)
 {
   // use idx as default affinity, overwritten by device tree
   _dt_affinity = idx;
@@ -100,6 +100,19 @@ public:
     _smccc_handlers[method].push_back(handler);
   }
 
+  /**
+   * Check whether a handler registered for `method` implements the SMCCC
+   * function `func_id`.
+   */
+  bool smccc_has_feature(Smccc_method method, l4_uint32_t func_id) const
+  {
+    for (auto const &h: _smccc_handlers[method])
+      if (h->has_feature(func_id))
+        return true;
+
+    return false;
+  }
+
   template <Smccc_method METHOD>
   void handle_smccc_call(Vcpu_ptr vcpu)
   {
@@ -470,6 +470,7 @@ Guest::handle_entry(Vcpu_ptr vcpu)
 
   vcpu.process_pending_ipc(utcb);
   _gic->schedule_irqs(vmm_current_cpu_id);
+  _cpus->cpu(vmm_current_cpu_id)->update_steal_time();
 
   L4::Cap<L4::Thread> myself;
   return myself->vcpu_resume_start(utcb);
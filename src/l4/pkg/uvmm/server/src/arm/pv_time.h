@@ -0,0 +1,37 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+#include <l4/sys/l4int.h>
+
+namespace Vmm {
+
+/**
+ * Stolen time structure of a vCPU, as defined by the Arm paravirtualized
+ * time specification (DEN0057A).
+ */
+struct Pv_time_stolen
+{
+  l4_uint32_t revision;
+  l4_uint32_t attributes;
+  l4_uint64_t stolen_time;
+  l4_uint8_t  pad[48];
+
+  void reset()
+  {
+    revision = 0;
+    attributes = 0;
+    publish(0);
+  }
+
+  /// Store the stolen time in nanoseconds, guests read it in one access.
+  void publish(l4_uint64_t ns)
+  { __atomic_store_n(&stolen_time, ns, __ATOMIC_RELAXED); }
+};
+static_assert(sizeof(Pv_time_stolen) == 64,
+              "Pv_time_stolen structure is compact.");
+
+} // namespace
@@ -58,6 +58,13 @@ class Psci_device : public Vdev::Device, public Vmm::Smccc_device
     Psci_stat_count       = 17,
   };
 
+  /// SMC Calling Convention architecture calls, discovered via PSCI.
+  enum Smccc_arch_functions : l4_uint32_t
+  {
+    Smccc_version       = 0x80000000,
+    Smccc_arch_features = 0x80000001,
+  };
+
   enum Psci_migrate_info
   {
     Tos_up_mig_cap     = 0,
@@ -86,10 +93,12 @@ class Psci_device : public Vdev::Device, public Vmm::Smccc_device
 
 public:
   Psci_device(Vmm::Guest *vmm, cxx::Ref_ptr<Vmm::Pm> pm,
-              cxx::Ref_ptr<Vmm::Cpu_dev_array> cpus)
+              cxx::Ref_ptr<Vmm::Cpu_dev_array> cpus,
+              Vmm::Guest::Smccc_method method)
   : _vmm(vmm),
     _pm(pm),
-    _cpus(cpus)
+    _cpus(cpus),
+    _method(method)
   {}
 
   bool vm_call(unsigned imm, Vmm::Vcpu_ptr vcpu) override
@@ -97,6 +106,16 @@ public:
     if (imm != 0)
       return false;
 
+    switch (static_cast<l4_uint32_t>(vcpu->r.r[0]))
+      {
+      case Smccc_version:
+        vcpu->r.r[0] = 0x10001; // v1.1
+        return true;
+      case Smccc_arch_features:
+        smccc_arch_features(vcpu);
+        return true;
+      }
+
     // Check this is a supported PSCI function call id.
     if (!is_valid_func_id(vcpu->r.r[0]))
       return false;
@@ -221,8 +240,24 @@ private:
         }
   }
 
+  void smccc_arch_features(Vmm::Vcpu_ptr vcpu)
+  {
+    l4_uint32_t func = vcpu->r.r[1];
+    if (func == Smccc_arch_features || _vmm->smccc_has_feature(_method, func))
+      vcpu->r.r[0] = Success;
+    else
+      vcpu->r.r[0] = Not_supported;
+  }
+
   void psci_features(Vmm::Vcpu_ptr vcpu)
   {
+    // Guests discover SMCCC version 1.1 and later through PSCI_FEATURES.
+    if (static_cast<l4_uint32_t>(vcpu->r.r[1]) == Smccc_version)
+      {
+        vcpu->r.r[0] = Success;
+        return;
+      }
+
     // Check this uses an allowed SMCCC bitness and is a valid PSCI
     // function id.
     if (!(   is_valid_call(vcpu->r.r[1])
@@ -328,6 +363,7 @@ private:
   Vmm::Guest *_vmm;
   cxx::Ref_ptr<Vmm::Pm> _pm;
   cxx::Ref_ptr<Vmm::Cpu_dev_array> _cpus;
+  Vmm::Guest::Smccc_method _method;
 };
 
 struct F : Factory
@@ -335,7 +371,6 @@ struct F : Factory
   cxx::Ref_ptr<Device> create(Vdev::Device_lookup *devs,
                               Dt_node const &node) override
   {
-    auto c = make_device<Psci_device>(devs->vmm(), devs->pm(), devs->cpus());
     Vmm::Guest::Smccc_method smccc_method = Vmm::Guest::Hvc;
 
     char const *method = node.get_prop<char>("method", nullptr);
@@ -348,6 +383,9 @@ struct F : Factory
                       method);
       }
 
+    auto c = make_device<Psci_device>(devs->vmm(), devs->pm(), devs->cpus(),
+                                      smccc_method);
+
     info.printf("Register PSCI device: %s mode\n",
                 smccc_method == Vmm::Guest::Hvc ? "hvc" : "smc");
 
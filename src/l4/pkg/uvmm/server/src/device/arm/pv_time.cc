@@ -0,0 +1,162 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Arm paravirtualized time (DEN0057A), reporting the time a vCPU was ready
+ * to run but throttled by the scheduling constraints of its thread as
+ * stolen time.
+ *
+ * The stolen time structures of all vCPUs live in the guest-physical region
+ * given by `reg`, which must not overlap RAM. Guests discover the interface
+ * through SMCCC_ARCH_FEATURES, which requires the PSCI device with the same
+ * `method`.
+ *
+ * Example device tree entry:
+ *
+ *   pv_time {
+ *       compatible = "l4vmm,pv-time";
+ *       reg = <0x0 0x80000 0x0 0x1000>;
+ *       method = "hvc";
+ *   };
+ */
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/re/util/cap_alloc>
+
+#include "cpu_dev_array.h"
+#include "debug.h"
+#include "device_factory.h"
+#include "ds_manager.h"
+#include "ds_mmio_mapper.h"
+#include "guest.h"
+#include "pv_time.h"
+
+#include "smccc_device.h"
+
+namespace {
+
+using namespace Vdev;
+
+static Dbg warn(Dbg::Dev, Dbg::Warn, "pv_time");
+static Dbg info(Dbg::Dev, Dbg::Info, "pv_time");
+
+class Pv_time_device : public Vdev::Device, public Vmm::Smccc_device
+{
+  enum Pv_time_functions : l4_uint32_t
+  {
+    Pv_time_features = 0xc5000020,
+    Pv_time_st       = 0xc5000021,
+  };
+
+  enum { Success = 0 };
+
+public:
+  Pv_time_device(cxx::Ref_ptr<Vmm::Ds_manager> mem, Vmm::Guest_addr base,
+                 cxx::Ref_ptr<Vmm::Cpu_dev_array> cpus)
+  : _mem(mem), _base(base), _cpus(cpus)
+  {}
+
+  bool vm_call(unsigned imm, Vmm::Vcpu_ptr vcpu) override
+  {
+    if (imm != 0)
+      return false;
+
+    switch (static_cast<l4_uint32_t>(vcpu->r.r[0]))
+      {
+      case Pv_time_features:
+        vcpu->r.r[0] = has_feature(vcpu->r.r[1]) ? Success : Not_supported;
+        return true;
+      case Pv_time_st:
+        pv_time_st(vcpu);
+        return true;
+      default:
+        return false;
+      }
+  }
+
+  bool has_feature(l4_uint32_t func_id) const override
+  { return func_id == Pv_time_features || func_id == Pv_time_st; }
+
+private:
+  void pv_time_st(Vmm::Vcpu_ptr vcpu)
+  {
+    unsigned id = vmm_current_cpu_id;
+    assert(id < Vmm::Cpu_dev::Max_cpus);
+
+    auto *st = _mem->local_addr<Vmm::Pv_time_stolen *>() + id;
+    _cpus->cpu(id)->enable_steal_time(st);
+
+    info.printf("Stolen time of CPU %u at 0x%lx\n", id,
+                _base.get() + id * sizeof(*st));
+    vcpu->r.r[0] = _base.get() + id * sizeof(*st);
+  }
+
+  cxx::Ref_ptr<Vmm::Ds_manager> _mem;
+  Vmm::Guest_addr _base;
+  cxx::Ref_ptr<Vmm::Cpu_dev_array> _cpus;
+};
+
+struct F : Factory
+{
+  cxx::Ref_ptr<Device> create(Vdev::Device_lookup *devs,
+                              Dt_node const &node) override
+  {
+    l4_uint64_t base, size;
+    int res = node.get_reg_val(0, &base, &size);
+    if (res < 0)
+      {
+        warn.printf("Invalid reg entry '%s'.reg[0]: %s\n",
+                    node.get_name(), fdt_strerror(res));
+        return nullptr;
+      }
+
+    l4_size_t need = l4_round_page(Vmm::Cpu_dev::Max_cpus
+                                   * sizeof(Vmm::Pv_time_stolen));
+    if (size < need || (base & ~L4_PAGEMASK))
+      {
+        warn.printf("%s: reg must be page aligned and cover 0x%zx bytes\n",
+                    node.get_name(), need);
+        return nullptr;
+      }
+
+    L4Re::Util::Ref_cap<L4Re::Dataspace>::Cap ds
+      = L4Re::chkcap(L4Re::Util::make_ref_cap<L4Re::Dataspace>(),
+                     "Allocate dataspace capability for stolen time.");
+    L4Re::chksys(L4Re::Env::env()->mem_alloc()->alloc(need, ds.get()),
+                 "Allocate memory for stolen time.");
+
+    auto mem = cxx::make_ref_obj<Vmm::Ds_manager>(ds, 0, need);
+    devs->vmm()->add_mmio_device(
+                   Vmm::Region::ss(Vmm::Guest_addr(base), need,
+                                   Vmm::Region_type::Virtual),
+                   Vdev::make_device<Ds_handler>(mem));
+    node.update_reg_size(0, need);
+
+    Vmm::Guest::Smccc_method smccc_method = Vmm::Guest::Hvc;
+    char const *method = node.get_prop<char>("method", nullptr);
+    if (method)
+      {
+        if (strcmp(method, "smc") == 0)
+          smccc_method = Vmm::Guest::Smc;
+        else if (strcmp(method, "hvc") != 0)
+          warn.printf("Method '%s' is not supported. Must be hvc or smc!\n",
+                      method);
+      }
+
+    auto c = make_device<Pv_time_device>(mem, Vmm::Guest_addr(base),
+                                         devs->cpus());
+    devs->vmm()->register_vm_handler(smccc_method, c);
+
+    info.printf("Register PV time device: %s mode\n",
+                smccc_method == Vmm::Guest::Hvc ? "hvc" : "smc");
+
+    return c;
+  }
+};
+
+static F f;
+static Device_type t = { "l4vmm,pv-time", nullptr, &f };
+}
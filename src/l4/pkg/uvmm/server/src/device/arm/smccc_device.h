@@ -34,6 +34,18 @@ struct Smccc_device : public virtual Vdev::Dev_ref
    */
   virtual bool vm_call(unsigned imm, Vcpu_ptr vcpu) = 0;
 
+  /**
+   * Check whether the device implements an SMCCC function, as queried by
+   * the guest through SMCCC_ARCH_FEATURES.
+   *
+   * \param func_id  Function identifier.
+   */
+  virtual bool has_feature(l4_uint32_t func_id) const
+  {
+    (void)func_id;
+    return false;
+  }
+
   static constexpr bool is_64bit_call(l4_umword_t reg)
   {
     // Bit 30 must be set for 64 bit calls
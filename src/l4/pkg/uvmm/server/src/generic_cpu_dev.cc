@@ -39,9 +39,12 @@ Generic_cpu_dev::powerup_cpu()
 {
   unsigned id = _vcpu.get_vcpu_id();
 
+  _sched.create_constraints();
+
   if (id == 0)
     {
       _thread = pthread_self();
+      _sched.attach_constraints(Pthread::L4::cap(_thread));
       reschedule();
     }
   else
@@ -64,6 +67,8 @@ Generic_cpu_dev::powerup_cpu()
       if (err != 0)
         L4Re::chksys(-L4_EAGAIN, "Cannot start vcpu thread");
 
+      _sched.attach_constraints(Pthread::L4::cap(_thread));
+
       _bm = cxx::make_unique<L4Re::Util::Br_manager>();
       _registry = cxx::make_unique<L4Re::Util::Object_registry>(
         _bm.get(), thread_cap(), L4Re::Env::env()->factory());
@@ -82,13 +87,8 @@ Generic_cpu_dev::reschedule()
     .printf("reschedule(): Initiating cpu startup for %lx\n",
             Pthread::L4::cap(_thread).cap());
 
-  l4_sched_param_t sp = l4_sched_param(2);
-  sp.affinity = l4_sched_cpu_set(_phys_cpu_id, 0);
-
-  auto sched = L4Re::Env::env()->scheduler();
-  L4Re::chksys(sched->set_prio(Pthread::L4::cap(_thread), 2));
-  L4Re::chksys(sched->run_thread(Pthread::L4::cap(_thread), sp),
-               "Schedule vCPU on new core.");
+  _sched.run_thread(Pthread::L4::cap(_thread), _phys_cpu_id,
+                    _sched.vcpu_prio());
 }
 
 }
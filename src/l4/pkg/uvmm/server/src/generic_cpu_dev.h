@@ -20,6 +20,7 @@
 #include <debug.h>
 #include <device.h>
 #include <vcpu_ptr.h>
+#include <vcpu_sched.h>
 
 namespace Vmm {
 
@@ -39,9 +40,11 @@ private:
   }
 
 public:
-  Generic_cpu_dev(unsigned idx, unsigned phys_id)
+  Generic_cpu_dev(unsigned idx, unsigned phys_id, Vdev::Dt_node const *node)
   : _vcpu(nullptr), _phys_cpu_id(phys_id)
   {
+    _sched.init(node);
+
     // The CPU 0 (boot CPU) vCPU is allocated in main
     if (_main_vcpu_used || (idx != 0))
       _vcpu = alloc_vcpu(idx);
@@ -77,6 +80,10 @@ public:
   L4::Cap<L4::Thread> thread_cap() const
   { return Pthread::L4::cap(_thread); }
 
+  /// Scheduling parameters and constraints of this vCPU.
+  Vcpu_sched const &sched() const
+  { return _sched; }
+
   static Vcpu_ptr main_vcpu() { return _main_vcpu; }
 
   static void alloc_main_vcpu()
@@ -98,6 +105,7 @@ protected:
   cxx::unique_ptr<L4Re::Util::Br_manager> _bm;
   cxx::unique_ptr<L4Re::Util::Object_registry> _registry;
   bool _attached = false;
+  Vcpu_sched _sched;
 
 private:
   static Vcpu_ptr _main_vcpu;
@@ -0,0 +1,91 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+#include <l4/re/env>
+#include <l4/sys/kip.h>
+#include <l4/sys/scheduler>
+#include <l4/sys/thread>
+
+#include "debug.h"
+
+namespace Vmm {
+
+/**
+ * Steal time reporting for a single vCPU.
+ *
+ * The steal time is the time the vCPU thread was ready to run but blocked
+ * by one of its scheduling constraints, as accounted by the kernel. It is
+ * published to the guest in the steal time area registered by the guest,
+ * whose layout is defined by `AREA`: it provides `reset()` to clear the area
+ * and `publish(ns)` to store the steal time in nanoseconds.
+ *
+ * update() must be called from the vCPU thread before resuming the guest.
+ * Querying the kernel costs a system call, so the area is refreshed at most
+ * once per Update_interval.
+ */
+template <typename AREA>
+class Steal_time
+{
+public:
+  enum : l4_kernel_clock_t { Update_interval = 1000 /* µs */ };
+
+  /**
+   * Register the guest's steal time area.
+   *
+   * \param st      Host address of the area, nullptr to disable reporting.
+   * \param thread  vCPU thread.
+   */
+  void enable(AREA *st, L4::Cap<L4::Thread> thread)
+  {
+    _st = nullptr;
+    if (!st)
+      return;
+
+    l4_kernel_clock_t now;
+    if (l4_error(L4Re::Env::env()->scheduler()->steal_time(thread, &now)) < 0)
+      {
+        Dbg(Dbg::Cpu, Dbg::Warn)
+          .printf("Kernel does not report steal time. Disabled.\n");
+        return;
+      }
+
+    _base = now;
+    _last_update = 0;
+    st->reset();
+    _st = st;
+  }
+
+  /**
+   * Refresh the steal time area if it is due.
+   *
+   * \param thread  vCPU thread, must be the calling thread.
+   */
+  void update(L4::Cap<L4::Thread> thread)
+  {
+    if (L4_LIKELY(!_st))
+      return;
+
+    l4_kernel_clock_t now = l4_kip_clock(l4re_kip());
+    if (now - _last_update < Update_interval)
+      return;
+
+    _last_update = now;
+
+    l4_kernel_clock_t us;
+    if (l4_error(L4Re::Env::env()->scheduler()->steal_time(thread, &us)) < 0)
+      return;
+
+    _st->publish((us - _base) * 1000);
+  }
+
+private:
+  AREA *_st = nullptr;
+  l4_kernel_clock_t _base = 0;
+  l4_kernel_clock_t _last_update = 0;
+};
+
+} // namespace
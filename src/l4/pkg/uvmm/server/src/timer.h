@@ -51,6 +51,7 @@
 #include <l4/util/util.h>
 
 #include "device.h"
+#include "vcpu_sched.h"
 
 namespace Vdev {
 
@@ -163,16 +164,16 @@ public:
    *
    * \param vcpu_no      Guest vCPU number to run the timer for.
    * \param phys_cpu_id  Scheduler id of the physical core to run on.
+   * \param sched        Scheduling parameters of the vCPU. The timer thread
+   *                     shares the scheduling constraints of the vCPU.
    */
-  void run_timer(unsigned vcpu_no, unsigned phys_cpu_id)
+  void run_timer(unsigned vcpu_no, unsigned phys_cpu_id,
+                 Vmm::Vcpu_sched const *sched)
   {
     // raise timer thread prio above vcpu prio
-    l4_sched_param_t sp = l4_sched_param(3);
-    sp.affinity = l4_sched_cpu_set(phys_cpu_id, 0);
-    auto sched = L4Re::Env::env()->scheduler();
-    L4Re::chksys(sched->set_prio(Pthread::L4::cap(pthread_self()), 3));
-    L4Re::chksys(sched->run_thread(Pthread::L4::cap(pthread_self()), sp),
-                 "Run timer thread.");
+    sched->attach_constraints(Pthread::L4::cap(pthread_self()));
+    sched->run_thread(Pthread::L4::cap(pthread_self()), phys_cpu_id,
+                      sched->timer_prio());
 
     // instantiate server loop
     _server = new L4Re::Util::Registry_server<Loop_hooks>(
@@ -193,10 +194,13 @@ public:
    *
    * \param vcpu_no      Guest vCPU number to run the timer for.
    * \param phys_cpu_id  Scheduler id of the physical core to run on.
+   * \param sched        Scheduling parameters of the vCPU.
    */
-  void start_timer_thread(unsigned vcpu_no, unsigned phys_cpu_id)
+  void start_timer_thread(unsigned vcpu_no, unsigned phys_cpu_id,
+                          Vmm::Vcpu_sched const *sched)
   {
-    _thread = std::thread(&Clock_source::run_timer, this, vcpu_no, phys_cpu_id);
+    _thread = std::thread(&Clock_source::run_timer, this, vcpu_no, phys_cpu_id,
+                          sched);
   }
 
   // Clock_source_adapter
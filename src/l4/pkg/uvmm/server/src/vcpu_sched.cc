@@ -0,0 +1,143 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+
+#include "vcpu_sched.h"
+
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/re/util/cap_alloc>
+#include <l4/sys/kip.h>
+#include <l4/sys/sched_constraint.h>
+
+#include "debug.h"
+
+namespace Vmm {
+
+static bool
+read_cells(Vdev::Dt_node const *node, char const *name,
+           l4_uint64_t *vals, unsigned num)
+{
+  int prop_size;
+  auto *prop = node->get_prop<fdt32_t>(name, &prop_size);
+  if (!prop)
+    return false;
+
+  if (prop_size != static_cast<int>(num))
+    {
+      Err().printf("%s: '%s' needs %u cells. Ignored.\n",
+                   node->get_name(), name, num);
+      return false;
+    }
+
+  for (unsigned i = 0; i < num; ++i)
+    vals[i] = fdt32_to_cpu(prop[i]);
+
+  return true;
+}
+
+void
+Vcpu_sched::init(Vdev::Dt_node const *node)
+{
+  if (!node)
+    return;
+
+  l4_uint64_t v[2];
+  if (read_cells(node, "l4vmm,sched-prio", v, 1))
+    _vcpu_prio = v[0];
+
+  if (read_cells(node, "l4vmm,timer-prio", v, 1))
+    _timer_prio = v[0];
+
+  if (read_cells(node, "l4vmm,sched-budget", v, 2))
+    {
+      if (v[0] == 0 || v[0] > v[1])
+        Err().printf("%s: invalid scheduling budget %llu/%llu. Ignored.\n",
+                     node->get_name(), v[0], v[1]);
+      else
+        {
+          _budget = v[0];
+          _period = v[1];
+        }
+    }
+
+  if (read_cells(node, "l4vmm,sched-window", v, 2))
+    {
+      _window_start = v[0];
+      _window_duration = v[1];
+    }
+}
+
+void
+Vcpu_sched::create_constraints()
+{
+  if (_created)
+    return;
+
+  _created = true;
+
+  auto *e = L4Re::Env::env();
+
+  if (_budget)
+    {
+      _budget_sc = L4Re::chkcap(L4Re::Util::cap_alloc.alloc<L4::Budget_sc>(),
+                                "Allocate budget constraint capability");
+      auto cs = e->factory()->create(_budget_sc);
+      cs << l4_umword_t(L4_SCHED_CONSTRAINT_TYPE_BUDGET);
+      cs << l4_umword_t(_budget);
+      cs << l4_umword_t(_period);
+      L4Re::chksys(cs, "Create vCPU budget constraint");
+
+      Dbg(Dbg::Cpu, Dbg::Info)
+        .printf("vCPU budget: %lluus every %lluus\n", _budget, _period);
+    }
+
+  if (_window_duration)
+    {
+      _window_sc =
+        L4Re::chkcap(L4Re::Util::cap_alloc.alloc<L4::Timer_window_sc>(),
+                     "Allocate timer window constraint capability");
+      l4_uint64_t start = l4_kip_clock(l4re_kip()) + _window_start;
+      auto cs = e->factory()->create(_window_sc);
+      cs << l4_umword_t(L4_SCHED_CONSTRAINT_TYPE_TIMER_WINDOW);
+      cs << l4_umword_t(start);
+      cs << l4_umword_t(_window_duration);
+      L4Re::chksys(cs, "Create vCPU timer window constraint");
+
+      Dbg(Dbg::Cpu, Dbg::Info)
+        .printf("vCPU window: %lluus starting at %llu\n",
+                _window_duration, start);
+    }
+}
+
+void
+Vcpu_sched::attach_constraints(L4::Cap<L4::Thread> thread) const
+{
+  auto sched = L4Re::Env::env()->scheduler();
+
+  if (_budget_sc.is_valid())
+    L4Re::chksys(sched->attach_sc(thread, _budget_sc),
+                 "Attach vCPU budget constraint.");
+
+  if (_window_sc.is_valid())
+    L4Re::chksys(sched->attach_sc(thread, _window_sc),
+                 "Attach vCPU timer window constraint.");
+}
+
+void
+Vcpu_sched::run_thread(L4::Cap<L4::Thread> thread, unsigned phys,
+                       unsigned prio) const
+{
+  auto sched = L4Re::Env::env()->scheduler();
+
+  l4_sched_param_t sp = l4_sched_param(prio);
+  sp.affinity = l4_sched_cpu_set(phys, 0);
+
+  L4Re::chksys(sched->set_prio(thread, prio));
+  L4Re::chksys(sched->run_thread(thread, sp),
+               "Schedule thread on physical core.");
+}
+
+}
@@ -0,0 +1,94 @@
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+#include <l4/sys/scheduler>
+#include <l4/sys/sched_constraint>
+#include <l4/sys/thread>
+
+#include <device.h>
+
+namespace Vmm {
+
+/**
+ * Scheduling parameters of a single vCPU.
+ *
+ * The parameters are read from the CPU node of the device tree:
+ *
+ *   - `l4vmm,sched-prio = <prio>`: priority of the vCPU thread (default 2).
+ *   - `l4vmm,timer-prio = <prio>`: priority of the timer thread of the
+ *     vCPU, if the architecture uses one (default 3).
+ *   - `l4vmm,sched-budget = <budget period>`: the vCPU may run for `budget`
+ *     microseconds in every period of `period` microseconds.
+ *   - `l4vmm,sched-window = <start duration>`: the vCPU may only run for
+ *     `duration` microseconds, starting `start` microseconds after it was
+ *     powered up.
+ *
+ * The budget and window constraints are shared between the vCPU thread and
+ * its timer thread, so both count against the same budget.
+ */
+class Vcpu_sched
+{
+public:
+  enum : unsigned
+  {
+    Default_vcpu_prio = 2,
+    Default_timer_prio = 3,
+  };
+
+  /**
+   * Read the scheduling parameters from a CPU node.
+   *
+   * \param node  CPU device tree node, may be nullptr.
+   */
+  void init(Vdev::Dt_node const *node);
+
+  /**
+   * Create the scheduling constraints described by the parameters.
+   *
+   * Does nothing when called a second time.
+   */
+  void create_constraints();
+
+  /**
+   * Attach the constraints to a thread.
+   *
+   * \param thread  Thread of the vCPU.
+   *
+   * Must be called once per thread, when it is created. The kernel refuses
+   * to attach a constraint to a thread a second time.
+   */
+  void attach_constraints(L4::Cap<L4::Thread> thread) const;
+
+  /**
+   * Run a thread on a physical CPU.
+   *
+   * \param thread  Thread to schedule.
+   * \param phys    Scheduler id of the physical core to run on.
+   * \param prio    Priority of the thread.
+   *
+   * May be called whenever the vCPU is (re)started.
+   */
+  void run_thread(L4::Cap<L4::Thread> thread, unsigned phys,
+                  unsigned prio) const;
+
+  unsigned vcpu_prio() const { return _vcpu_prio; }
+  unsigned timer_prio() const { return _timer_prio; }
+
+private:
+  unsigned _vcpu_prio = Default_vcpu_prio;
+  unsigned _timer_prio = Default_timer_prio;
+  l4_uint64_t _budget = 0;
+  l4_uint64_t _period = 0;
+  l4_uint64_t _window_start = 0;
+  l4_uint64_t _window_duration = 0;
+  bool _created = false;
+
+  L4::Cap<L4::Budget_sc> _budget_sc;
+  L4::Cap<L4::Timer_window_sc> _window_sc;
+};
+
+}
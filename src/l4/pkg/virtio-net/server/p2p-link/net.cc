@@ -15,9 +15,11 @@
 #include <l4/re/util/meta>
 #include <l4/re/util/object_registry>
 #include <l4/re/util/br_manager>
+#include <l4/re/util/unique_cap>
 
 #include <l4/sys/factory>
 #include <l4/sys/compiler.h>
+#include <l4/sys/scheduler>
 
 #include <l4/sys/cxx/ipc_epiface>
 #include <l4/sys/cxx/ipc_varg>
@@ -38,8 +40,12 @@
 #include <climits>
 #include <getopt.h>
 
+#include <atomic>
 #include <cstdio>
+#include <mutex>
+#include <vector>
 #include <pthread.h>
+#include <pthread-l4.h>
 #include <debug.h>
 #include <checksum.h>
 
@@ -80,11 +86,24 @@ struct Virtqueue : L4virtio::Svr::Virtqueue
 
 };
 
+struct Buffer : Data_buffer
+{
+  Buffer() = default;
+  Buffer(L4virtio::Svr::Driver_mem_region const *r,
+         Virtqueue::Desc const &d,
+         Request_processor const *)
+  {
+    pos = static_cast<char *>(r->local(d.addr));
+    left = d.len;
+  }
+};
+
 enum
 {
   Merge_rx_buffers = true,
   Csum_offload     = true,
   Full_segmentation_offload = false,
+  Max_queue_pairs  = 16,
 };
 
 static struct option options[] =
@@ -92,6 +111,8 @@ static struct option options[] =
     {"size",        1, 0, 's'},  // size of in/out queue == #buffers in queue
     {"poll",        1, 0, 'p'},  // enable polling mode
     {"register-ds", 1, 0, 'd'},  // register a trusted dataspace
+    {"threads",     0, 0, 't'},  // one forwarding thread per direction
+    {"queue-pairs", 1, 0, 'q'},  // queue pairs per port (VIRTIO_NET_F_MQ)
     {0, 0, 0, 0}
 };
 
@@ -158,6 +179,15 @@ public:
     Tx = 1,
   };
 
+  /// Control queue commands and results.
+  enum
+  {
+    Ctrl_ok              = 0, // VIRTIO_NET_OK
+    Ctrl_err             = 1, // VIRTIO_NET_ERR
+    Ctrl_mq              = 4, // VIRTIO_NET_CTRL_MQ
+    Ctrl_mq_vq_pairs_set = 0, // VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET
+  };
+
 #ifdef CONFIG_STATS
   unsigned long num_tx;
   unsigned long num_rx;
@@ -169,20 +199,34 @@ public:
   {
     /// MAC address of the device (if VIRTIO_NET_F_MAC aka Features::mac)
     Mac_address mac;
+    /// Link status (if VIRTIO_NET_F_STATUS aka Features::status)
+    l4_uint16_t status;
+    /// Maximum number of queue pairs (if VIRTIO_NET_F_MQ aka Features::mq)
+    l4_uint16_t max_virtqueue_pairs;
   };
 
   L4virtio::Svr::Dev_config_t<Net_config_space> _dev_config;
 
-  explicit Virtio_net(unsigned vq_max)
+  /**
+   * Number of queues of a device with the given number of queue pairs.
+   *
+   * With multiple queue pairs the control queue follows the last pair.
+   */
+  static unsigned num_queues(unsigned pairs)
+  { return pairs > 1 ? 2 * pairs + 1 : 2; }
+
+  explicit Virtio_net(unsigned vq_max, unsigned pairs = 1)
   : L4virtio::Svr::Device(&_dev_config),
-    _dev_config(L4VIRTIO_VENDOR_KK, L4VIRTIO_ID_NET, 2),
-    _vq_max(vq_max), _enabled_features(0), _poll_mode(false)
+    _dev_config(L4VIRTIO_VENDOR_KK, L4VIRTIO_ID_NET, num_queues(pairs)),
+    _vq_max(vq_max), _pairs(pairs), _active_pairs(1),
+    _q(new Virtqueue[2 * pairs]), _enabled_features(0), _poll_mode(false)
 #ifdef CONFIG_STATS
     , num_tx(0), num_rx(0), num_dropped(0), num_irqs(0)
 #endif
   {
     Features hf(0);
     hf.ring_indirect_desc() = true;
+    hf.ring_event_idx() = true;
 
     hf.csum()       = Csum_offload;
     hf.guest_csum() = Csum_offload;
@@ -201,13 +245,20 @@ public:
         hf.guest_ecn()  = true;
       }
 
+    if (pairs > 1)
+      {
+        hf.mq()      = true;
+        hf.ctrl_vq() = true;
+        _dev_config.priv_config()->max_virtqueue_pairs = pairs;
+      }
+
     _dev_config.host_features(0) = hf.raw;
 
     _dev_config.set_host_feature(L4VIRTIO_FEATURE_VERSION_1);
     _dev_config.reset_hdr();
 
-    reset_queue_config(0, vq_max);
-    reset_queue_config(1, vq_max);
+    for (unsigned i = 0; i < num_queues(pairs); ++i)
+      reset_queue_config(i, vq_max);
   }
 
   void set_mac_address(Mac_address const &mac)
@@ -244,13 +295,41 @@ public:
   L4::Cap<L4::Irq> device_notify_irq() const
   { return _host_irq; }
 
-  void reset()
+  /**
+   * Get the device notification IRQ for the given index.
+   *
+   * Queue pair `i` uses index `i` and the control queue uses the index
+   * after the last pair, see reconfig_queue().
+   */
+  L4::Cap<L4::Irq> device_notify_irq(unsigned idx) override
   {
-    for (Virtqueue &q: _q)
-      q.disable();
+    if (idx < _notify_irqs.size())
+      return _notify_irqs[idx];
+
+    return idx == 0 ? _host_irq : L4::Cap<L4::Irq>();
+  }
+
+  /**
+   * Set the device notification IRQs of the queue pairs and, as last
+   * element, of the control queue.
+   */
+  void set_notify_irqs(std::vector<L4::Cap<L4::Irq>> const &irqs)
+  { _notify_irqs = irqs; }
+
+  /**
+   * Set the locks of the forwarding threads using the queues of this port.
+   *
+   * When set, all locks are held while the queue configuration changes.
+   * They are taken in the order given, so all callers must pass them in the
+   * same order.
+   */
+  void set_queue_locks(std::vector<std::mutex *> const &locks)
+  { _queue_locks = locks; }
 
-    reset_queue_config(0, _vq_max);
-    reset_queue_config(1, _vq_max);
+  void reset()
+  {
+    Queue_guard g(this);
+    do_reset();
   }
 
   bool available()
@@ -264,18 +343,38 @@ public:
   const Features &enabled_features()
   { return _enabled_features; }
 
-  template<typename T, unsigned N >
-  static unsigned array_length(T (&)[N]) { return N; }
+  /**
+   * Get the queue with the given index.
+   *
+   * The index of the control queue depends on whether the driver accepted
+   * VIRTIO_NET_F_MQ, so this must not be called before FEATURES_OK.
+   */
+  Virtqueue *queue(unsigned index)
+  {
+    Features f(_dev_config.guest_features(0));
+    if (f.ctrl_vq() && index == 2 * (f.mq() ? _pairs : 1))
+      return &_ctrl_q;
+
+    if (index < 2 * _pairs)
+      return &_q[index];
+
+    return nullptr;
+  }
 
   int reconfig_queue(unsigned index)
   {
-    if (index >= array_length(_q))
+    Virtqueue *q = queue(index);
+    if (!q)
       return -L4_ERANGE;
 
-    if (setup_queue(_q + index, index, _vq_max))
+    Queue_guard g(this);
+
+    if (setup_queue(q, index, _vq_max))
       {
+        _dev_config.set_queue_notify_index(index,
+                                           q == &_ctrl_q ? _pairs : index / 2);
         if (_poll_mode)
-          _q[index].disable_notify();
+          q->disable_notify();
         return 0;
       }
 
@@ -284,17 +383,20 @@ public:
 
   bool check_queues()
   {
-    for (Virtqueue &q: _q)
-      if (!q.ready())
-        {
-          reset();
-          printf("failed to start queues\n");
-          return false;
-        }
+    Queue_guard g(this);
 
     l4_uint32_t guest_features = _dev_config.guest_features(0);
     l4_uint32_t features = guest_features & _dev_config.host_features(0);
 
+    // Queue pair 0 is mandatory, further pairs are forwarded once ready.
+    if (!rx_q()->ready() || !tx_q()->ready()
+        || (Features(features).ctrl_vq() && !_ctrl_q.ready()))
+      {
+        do_reset();
+        printf("failed to start queues\n");
+        return false;
+      }
+
     if (L4_UNLIKELY(guest_features != features))
       {
         Err().printf("error: guest enabled features we did not offer: %x\n",
@@ -307,14 +409,96 @@ public:
     return true;
   }
 
-  Virtqueue *tx_q() { return &_q[Tx]; }
-  Virtqueue *rx_q() { return &_q[Rx]; }
+  Virtqueue *tx_q(unsigned pair = 0) { return &_q[2 * pair + Tx]; }
+  Virtqueue *rx_q(unsigned pair = 0) { return &_q[2 * pair + Rx]; }
+
+  /// Number of queue pairs offered to the driver.
+  unsigned pairs() const { return _pairs; }
+
+  /// Number of queue pairs the driver uses, see handle_ctrl_queue().
+  unsigned active_pairs() const { return _active_pairs; }
+
+  /**
+   * Generation of active_pairs().
+   *
+   * Changes whenever the driver selects the number of queue pairs or the
+   * device is reset.
+   */
+  unsigned pairs_gen() const { return _pairs_gen; }
+
+  /**
+   * Process the requests on the control queue.
+   *
+   * Only VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET is supported, other commands are
+   * answered with VIRTIO_NET_ERR.
+   */
+  void handle_ctrl_queue()
+  {
+    Queue_guard g(this);
+
+    if (!_ctrl_q.ready())
+      return;
+
+    for (;;)
+      {
+        auto r = _ctrl_q.next_avail();
+        if (!r)
+          break;
+
+        // class, command and up to two bytes of command data
+        l4_uint8_t cmd[4] = { 0, 0, 0, 0 };
+        Data_buffer in(&cmd);
+        l4_uint8_t *ack = nullptr;
+
+        try
+          {
+            Request_processor p;
+            Buffer b;
+            p.start(mem_info(), r, &b);
+            do
+              {
+                // The result is the first byte of the last writable buffer.
+                if (p.current_flags().write())
+                  {
+                    if (b.left)
+                      ack = reinterpret_cast<l4_uint8_t *>(b.pos);
+                  }
+                else
+                  b.copy_to(&in);
+              }
+            while (p.next(mem_info(), &b));
+          }
+        catch (L4virtio::Svr::Bad_descriptor const &e)
+          {
+            Err().printf("error: control queue: %s\n", e.message());
+            device_error();
+            return;
+          }
+
+        l4_uint8_t result = Ctrl_err;
+        if (_enabled_features.mq() && in.done()
+            && cmd[0] == Ctrl_mq && cmd[1] == Ctrl_mq_vq_pairs_set)
+          {
+            unsigned n = cmd[2] | (cmd[3] << 8);
+            if (n >= 1 && n <= _pairs)
+              {
+                set_active_pairs(n);
+                result = Ctrl_ok;
+              }
+          }
+
+        if (ack)
+          *ack = result;
+
+        _ctrl_q.finish(r, this, ack ? 1 : 0);
+      }
+  }
 
 
   void notify_queue(L4virtio::Virtqueue *queue)
   {
     //printf("%s\n", __func__);
-    if (queue->no_notify_guest())
+    if (!queue->should_notify_guest())
       return;
 
     // we do not care about this anywhere, so skip
@@ -333,8 +517,8 @@ public:
     _dev_config.set_host_feature(L4VIRTIO_FEATURE_CMD_CONFIG);
     _dev_config.reset_hdr();
 
-    for (auto &q : _q)
-      q.disable_notify();
+    for (unsigned i = 0; i < 2 * _pairs; ++i)
+      _q[i].disable_notify();
   }
 
   char const *name;
@@ -352,10 +536,11 @@ public:
   template<typename REG>
   void unregister_client(REG *registry)
   {
-    reset();
-    reset_queue_config(0, _vq_max);
-    reset_queue_config(1, _vq_max);
-    init_mem_info(0);
+    {
+      Queue_guard g(this);
+      do_reset();
+      init_mem_info(0);
+    }
 
     registry->unregister_obj(this);
   }
@@ -363,12 +548,53 @@ public:
 private:
   friend void *stats_thread_loop(void *);
 
+  struct Queue_guard
+  {
+    explicit Queue_guard(Virtio_net *d) : _d(d)
+    {
+      for (std::mutex *l: _d->_queue_locks)
+        l->lock();
+    }
+
+    ~Queue_guard()
+    {
+      for (std::mutex *l: _d->_queue_locks)
+        l->unlock();
+    }
+
+    Virtio_net *_d;
+  };
+
+  void do_reset()
+  {
+    for (unsigned i = 0; i < 2 * _pairs; ++i)
+      _q[i].disable();
+    _ctrl_q.disable();
+
+    for (unsigned i = 0; i < num_queues(_pairs); ++i)
+      reset_queue_config(i, _vq_max);
+
+    set_active_pairs(1);
+  }
+
+  void set_active_pairs(unsigned n)
+  {
+    _active_pairs = n;
+    ++_pairs_gen;
+  }
+
   unsigned _vq_max;
-  Virtqueue _q[2];
+  unsigned _pairs;
+  unsigned _active_pairs;
+  std::atomic<unsigned> _pairs_gen{0};
+  cxx::unique_ptr<Virtqueue[]> _q;
+  Virtqueue _ctrl_q;
   L4Re::Util::Unique_cap<L4::Irq> _kick_guest_irq;
   L4::Cap<L4::Irq> _host_irq;
+  std::vector<L4::Cap<L4::Irq>> _notify_irqs;
   Features _enabled_features;
   bool _poll_mode;
+  std::vector<std::mutex *> _queue_locks;
 };
 
 static L4Re::Util::Registry_server<L4Re::Util::Br_manager_timeout_hooks> server;
@@ -451,6 +677,9 @@ private:
             more |= p->copy();
       }
 
+    for (auto p: pipe)
+      p->flush_notify();
+
     _poll_next += _poll_interval;
     server_iface()->add_timeout(this, _poll_next);
   }
@@ -515,17 +744,7 @@ public:
   L4::Epiface *irq_object()
   { return &_host_irq; }
 
-  struct Buffer : Data_buffer
-  {
-    Buffer() = default;
-    Buffer(L4virtio::Svr::Driver_mem_region const *r,
-           Virtqueue::Desc const &d,
-           Request_processor const *)
-    {
-      pos = static_cast<char *>(r->local(d.addr));
-      left = d.len;
-    }
-  };
+  struct Pipe;
 
   struct End_point : Request_processor
   {
@@ -540,10 +759,35 @@ public:
     enum { merge_rx = Merge_rx_buffers };
     enum { hdr_size = Merge_rx_buffers ? 12 : 10 };
 
+    /// A queue notification of the guest is pending, see flush_notify().
+    bool notify_pending = false;
+
+    /// Pipe forwarding from this end point if it transmits.
+    Pipe *owner = nullptr;
+
     End_point(Virtio_net *device, Virtqueue *queue) : dev(device), q(queue) {}
 
     void finish(l4_uint32_t total = 0)
-    { q->finish(head, dev, total); }
+    { q->finish(head, this, total); }
+
+    /**
+     * Queue observer collecting guest notifications.
+     *
+     * Finished buffers only mark the notification as pending so that a
+     * whole batch of packets costs a single interrupt in the guest.
+     */
+    void notify_queue(L4virtio::Virtqueue *)
+    { notify_pending = true; }
+
+    /// Send a pending guest notification.
+    void flush_notify()
+    {
+      if (!notify_pending)
+        return;
+
+      notify_pending = false;
+      dev->notify_queue(q);
+    }
 
     bool next()
     { return Request_processor::next(dev->mem_info(), &pkt); }
@@ -756,24 +1000,62 @@ public:
     }
   };
 
+  /**
+   * Forwarding from transmit queues of one port to a receive queue of the
+   * other port.
+   *
+   * There is one pipe per direction and queue pair. A pipe forwards from
+   * the transmit queue of its own pair and, if the receiving port uses fewer
+   * queue pairs than the transmitting one, from the transmit queues of
+   * further pairs, see Sock_pair::rebalance().
+   */
   struct Pipe
   {
     l4_uint32_t total;
-    End_point tx;
+    /// Transmit end point currently forwarded from, one of `txs`.
+    End_point *tx;
     End_point rx;
-
-    Pipe(Virtio_net *tx_port, Virtio_net *rx_port)
-    : tx(tx_port, tx_port->tx_q()),
-      rx(rx_port, rx_port->rx_q())
-    {}
+    /// Transmit end point of the same queue pair as `rx`.
+    End_point *home;
+    /// Transmit end points forwarded by this pipe.
+    std::vector<End_point *> txs;
+    /// Next element of `txs` to forward from.
+    unsigned next_tx = 0;
+
+    /// The pipe ran out of receive buffers, see Sock_pair::pipe_thread().
+    std::atomic<bool> rx_starved;
+
+    /// Forwarding thread and its notification IRQ, if enabled.
+    pthread_t thread;
+    L4Re::Util::Unique_cap<L4::Irq> irq;
+    /// Serializes forwarding against queue configuration changes.
+    std::mutex lock;
+    /// Pipe in the opposite direction.
+    Pipe *reverse = nullptr;
+    /// Link the pipe belongs to, if forwarding threads are enabled.
+    Sock_pair *link = nullptr;
+
+    Pipe(End_point *tx_ep, Virtio_net *rx_port, unsigned pair)
+    : tx(tx_ep),
+      rx(rx_port, rx_port->rx_q(pair)),
+      home(tx_ep),
+      txs(1, tx_ep),
+      rx_starved(false)
+    { tx_ep->owner = this; }
 
     bool ready() const
-    { return L4_LIKELY(tx.q->ready() && rx.q->ready()); }
+    { return L4_LIKELY(rx.q->ready()); }
 
     bool work_pending() const
     {
-      return L4_LIKELY(ready()) && tx.q->desc_avail()
-             && rx.q->desc_avail();
+      if (L4_UNLIKELY(!ready()) || !rx.q->desc_avail())
+        return false;
+
+      for (End_point *t: txs)
+        if (t->q->ready() && t->q->desc_avail())
+          return true;
+
+      return false;
     }
 
     void disable_notify()
@@ -781,7 +1063,8 @@ public:
       if (L4_UNLIKELY(!ready()))
         return;
 
-      tx.q->disable_notify();
+      for (End_point *t: txs)
+        t->q->disable_notify();
       rx.q->disable_notify();
     }
 
@@ -790,28 +1073,96 @@ public:
       if (L4_UNLIKELY(!ready()))
         return;
 
-      tx.q->enable_notify();
+      for (End_point *t: txs)
+        t->q->enable_notify();
       rx.q->enable_notify();
     }
 
     bool start_tx_packet()
     {
-      return tx.start_packet(true);
+      return tx->start_packet(true);
     }
 
     bool start_rx_packet()
     {
-      return rx.start_packet(false, &total, nmerge);
+      if (L4_LIKELY(rx.start_packet(false, &total, nmerge)))
+        return true;
+
+      rx_starved = true;
+      return false;
     }
 
-    unsigned nmerge;
+    void flush_notify()
+    {
+      for (End_point *t: txs)
+        t->flush_notify();
+      rx.flush_notify();
+    }
 
+    unsigned nmerge = 0;
+
+    /**
+     * Forward packets from the transmit end points of this pipe, round
+     * robin.
+     *
+     * A packet is always completed before switching to the next transmit
+     * end point, so the pipe stays with the current one if the receive
+     * queue ran out of buffers.
+     */
     bool copy()
+    {
+      bool more = false;
+      for (unsigned n = txs.size(); n; --n)
+        {
+          if (!tx->head)
+            {
+              tx = txs[next_tx];
+              if (++next_tx == txs.size())
+                next_tx = 0;
+            }
+
+          if (L4_LIKELY(tx->q->ready()))
+            more |= copy_packets();
+
+          if (tx->head)
+            break;
+        }
+
+      return more;
+    }
+
+    /**
+     * Drop a packet that was only partially forwarded.
+     *
+     * The receive buffers filled so far are passed to the guest like a
+     * truncated packet. A transmit packet that was not copied yet is kept.
+     */
+    void abort_packet()
+    {
+      if (L4_LIKELY(!tx || !tx->head || !nmerge))
+        return;
+
+      if (rx.q->ready())
+        {
+          rx.hdr->flags.raw = 0;
+          if (rx.merge_rx)
+            rx.hdr->num_buffers = nmerge;
+          rx.q->finish_x(nmerge, &rx);
+        }
+      nmerge = 0;
+
+      if (tx->q->ready())
+        tx->finish();
+      else
+        tx->head = Virtqueue::Head_desc();
+    }
+
+    bool copy_packets()
     {
       try
         {
           // loop over all chained descriptors (rx and tx)
-          if (!tx.head)
+          if (!tx->head)
             {
               nmerge = 0;
               if (L4_UNLIKELY(!start_tx_packet()))
@@ -821,24 +1172,24 @@ public:
           if (!rx.head && L4_UNLIKELY(!start_rx_packet()))
             return false;
 
-          Checksum_computer csum(&tx, &rx);
+          Checksum_computer csum(tx, &rx);
 
           for (;;)
             {
               if (0)
                 printf("%p: copy packet %p (%u) -> %p (%u)\n", this,
-                       tx.pkt.pos, tx.pkt.left, rx.pkt.pos, rx.pkt.left);
+                       tx->pkt.pos, tx->pkt.left, rx.pkt.pos, rx.pkt.left);
 
               csum.update();
 
-              total += tx.pkt.copy_to(&rx.pkt);
+              total += tx->pkt.copy_to(&rx.pkt);
 
-              if (tx.pkt.done() && !tx.next())
+              if (tx->pkt.done() && !tx->next())
                 {
                   if (0)
                     printf("%p: finish packet rx buffers: %u last total %u\n",
                            this, nmerge + 1, total);
-                  tx.finish();
+                  tx->finish();
 
                   if (!csum.finish())
                     {
@@ -851,7 +1202,7 @@ public:
                   if (rx.merge_rx)
                     rx.hdr->num_buffers = nmerge;
 
-                  rx.q->finish_x(nmerge, rx.dev);
+                  rx.q->finish_x(nmerge, &rx);
 
                   nmerge = 0;
                   if (L4_UNLIKELY(!start_tx_packet()))
@@ -871,7 +1222,7 @@ public:
                     {
                       printf("%p: truncated rx packet, drop\n", this);
                       rx.hdr->flags.raw = 0;
-                      rx.q->finish_x(nmerge, rx.dev);
+                      rx.q->finish_x(nmerge, &rx);
                     }
 
                   if (0)
@@ -887,16 +1238,16 @@ public:
         }
       catch (L4virtio::Svr::Bad_descriptor const &e)
         {
-          if (e.proc == &tx)
+          if (e.proc == tx)
             {
               // failed TX queue, be nice to RX part.
-              tx.dev->device_error();
+              tx->dev->device_error();
 
               if (rx.q->ready() && rx.head)
                 rx.finish(total);
 
               printf("error: TX queue error: bad descriptor: %d in device %p, queue %p\n",
-                     e.error, tx.dev, tx.q);
+                     e.error, tx->dev, tx->q);
             }
 
           if (e.proc == &rx)
@@ -904,8 +1255,8 @@ public:
               // failed RX queue, send half pkt to TX part.
               rx.dev->device_error();
 
-              if (tx.q->ready() && tx.head)
-                tx.finish();
+              if (tx->q->ready() && tx->head)
+                tx->finish();
 
               printf("error: RX queue error: bad descriptor: %d in device %p, queue %p\n",
                      e.error, rx.dev, rx.q);
@@ -916,29 +1267,33 @@ public:
     }
   };
 
-  enum { Npipes = 2, Nports = 2 };
+  enum { Nports = 2 };
   Virtio_net *port[Nports];
-  Pipe *pipe[Npipes];
+  /// Pipes, the one where port `d` transmits on queue pair `i` is 2*i + d.
+  std::vector<Pipe *> pipe;
 
   /**
    * \brief Create a new virtio Switch
    */
-  Sock_pair(unsigned vq_max)
+  Sock_pair(unsigned vq_max, unsigned pairs)
   : _host_irq(this),
     _del_cap_irq(port, Nports),
-    _poll_interval(0)
+    _poll_interval(0),
+    _pairs(pairs)
   {
     for (Virtio_net *&p: port)
       {
-        p = new Virtio_net(vq_max);
+        p = new Virtio_net(vq_max, pairs);
         p->add_trusted_dataspaces(trusted_dataspaces);
 
         if (!trusted_dataspaces->empty())
           p->enable_trusted_ds_validation();
       }
 
-    pipe[0] = new Pipe(port[0], port[1]);
-    pipe[1] = new Pipe(port[1], port[0]);
+    for (unsigned i = 0; i < pairs; ++i)
+      for (unsigned d = 0; d < Nports; ++d)
+        pipe.push_back(new Pipe(new End_point(port[d], port[d]->tx_q(i)),
+                                port[d ^ 1], i));
 
     auto c = L4Re::chkcap(server.registry()->register_irq_obj(&_del_cap_irq));
     L4Re::chksys(L4Re::Env::env()->main_thread()->register_del_irq(c));
@@ -1021,14 +1376,15 @@ public:
                opt.value<char const *>());
       }
 
-    for (auto *p: port)
+    for (unsigned i = 0; i < Nports; ++i)
       {
+        Virtio_net *p = port[i];
         if (p->available())
           {
             if (has_mac)
               p->set_mac_address(mac);
 
-            p->register_client(server.registry(), host_irq(), num_ds);
+            p->register_client(server.registry(), port_irq(i), num_ds);
             res = L4::Ipc::make_cap(p->obj_cap(), L4_CAP_FPAGE_RWSD);
 
             return L4_EOK;
@@ -1039,29 +1395,41 @@ public:
   }
 
   void kick()
+  { forward(pipe.data(), pipe.size()); }
+
+  /**
+   * Forward packets on a set of pipes until all of them run dry.
+   *
+   * Guest notifications are collected while copying and sent once per
+   * round.
+   */
+  static void forward(Pipe *const *pipes, unsigned num)
   {
     for (;;)
       {
-        for (auto *p: pipe)
-          p->disable_notify();
+        for (unsigned i = 0; i < num; ++i)
+          pipes[i]->disable_notify();
 
         for (bool more = true; more; )
           {
             more = false;
-            for (auto *p: pipe)
-              if (L4_LIKELY(p->ready()))
-                more |= p->copy();
+            for (unsigned i = 0; i < num; ++i)
+              if (L4_LIKELY(pipes[i]->ready()))
+                more |= pipes[i]->copy();
           }
 
-        for (auto *p: pipe)
-          p->enable_notify();
+        for (unsigned i = 0; i < num; ++i)
+          {
+            pipes[i]->flush_notify();
+            pipes[i]->enable_notify();
+          }
 
         L4virtio::wmb();
         L4virtio::rmb();
 
         bool work = false;
-        for (auto *p: pipe)
-          if (L4_UNLIKELY((work |= p->work_pending())))
+        for (unsigned i = 0; i < num; ++i)
+          if (L4_UNLIKELY((work |= pipes[i]->work_pending())))
             break;
 
         if (L4_LIKELY(!work))
@@ -1070,6 +1438,225 @@ public:
         // seems there is already new work to do ...
       }
   }
+
+  /**
+   * Notification IRQ to hand out to the client of a port.
+   */
+  L4::Cap<L4::Irq> port_irq(unsigned idx) const
+  {
+    // The guest on a port kicks the pipe it transmits on.
+    if (_threads)
+      return pipe[idx]->irq.get();
+
+    return host_irq();
+  }
+
+  /**
+   * Forward each direction of each queue pair of the link in a thread of its
+   * own.
+   *
+   * A guest notification for a queue pair wakes the thread of the pipe the
+   * guest transmits on. The same notification may announce new receive
+   * buffers for the opposite direction, so the woken thread passes it on if
+   * the other pipe ran out of receive buffers before.
+   *
+   * With multiple queue pairs each thread runs on a CPU of its own, as far as
+   * there are enough CPUs, and the control queues are handled by the main
+   * thread.
+   */
+  void enable_threads()
+  {
+    assert(!_threads);
+
+    printf("Enable one forwarding thread per direction and queue pair\n");
+
+    std::vector<std::mutex *> locks;
+    for (auto *p: pipe)
+      {
+        p->irq = L4Re::chkcap(L4Re::Util::make_unique_cap<L4::Irq>(),
+                              "Allocate pipe IRQ capability");
+        L4Re::chksys(L4Re::Env::env()->factory()->create(p->irq.get()),
+                     "Create pipe IRQ");
+        p->link = this;
+        locks.push_back(&p->lock);
+      }
+
+    // Port 0 transmits on pipe 2*i and receives on pipe 2*i + 1 of queue
+    // pair i, port 1 vice versa.
+    for (unsigned i = 0; i < _pairs; ++i)
+      {
+        pipe[2 * i]->reverse = pipe[2 * i + 1];
+        pipe[2 * i + 1]->reverse = pipe[2 * i];
+      }
+
+    for (unsigned d = 0; d < Nports; ++d)
+      {
+        port[d]->set_queue_locks(locks);
+
+        if (_pairs > 1)
+          {
+            std::vector<L4::Cap<L4::Irq>> irqs;
+            for (unsigned i = 0; i < _pairs; ++i)
+              irqs.push_back(pipe[2 * i + d]->irq.get());
+
+            _ctrl_irq[d].s = this;
+            _ctrl_irq[d].dev = port[d];
+            irqs.push_back(L4Re::chkcap(server.registry()
+                                          ->register_irq_obj(&_ctrl_irq[d]),
+                                        "Register control queue IRQ"));
+            port[d]->set_notify_irqs(irqs);
+          }
+      }
+
+    check_pairs();
+
+    l4_sched_cpu_set_t cpus = l4_sched_cpu_set(0, 0, 0);
+    if (_pairs > 1
+        && l4_error(L4Re::Env::env()->scheduler()->info(nullptr, &cpus)) < 0)
+      cpus.map = 0;
+
+    unsigned cpu = 0;
+    for (auto *p: pipe)
+      {
+        if (pthread_create(&p->thread, nullptr, pipe_thread, p))
+          L4Re::chksys(-L4_ENOMEM, "Create forwarding thread");
+
+        if (!cpus.map)
+          continue;
+
+        // distribute the threads round robin over the online CPUs
+        while (!(cpus.map & (1UL << cpu)))
+          cpu = (cpu + 1) % L4_MWORD_BITS;
+
+        cpu_set_t cs;
+        CPU_ZERO(&cs);
+        CPU_SET(cpu, &cs);
+        int e = pthread_setaffinity_np(p->thread, sizeof(cs), &cs);
+        if (e != 0)
+          Err().printf("warning: could not move forwarding thread to CPU %u: "
+                       "%d\n", cpu, e);
+
+        cpu = (cpu + 1) % L4_MWORD_BITS;
+      }
+
+    _threads = true;
+  }
+
+  /**
+   * Distribute the transmit end points among the pipes to port `rxd`.
+   *
+   * The transmit queue of pair `i` is forwarded to the receive queue of pair
+   * `i % n` of the receiving port, if it uses `n` queue pairs. All forwarding
+   * is stopped meanwhile, packets that are forwarded only partially are
+   * dropped.
+   */
+  void rebalance(unsigned rxd)
+  {
+    for (auto *p: pipe)
+      p->lock.lock();
+
+    unsigned gen = port[rxd]->pairs_gen();
+    if (gen != _pairs_gen[rxd])
+      {
+        _pairs_gen[rxd] = gen;
+
+        unsigned d = rxd ^ 1;
+        unsigned n = port[rxd]->active_pairs();
+        for (unsigned i = 0; i < _pairs; ++i)
+          {
+            Pipe *p = pipe[2 * i + d];
+            p->abort_packet();
+            p->flush_notify();
+            p->txs.clear();
+            p->next_tx = 0;
+          }
+
+        for (unsigned i = 0; i < _pairs; ++i)
+          {
+            Pipe *p = pipe[2 * (i % n) + d];
+            End_point *t = pipe[2 * i + d]->home;
+            p->txs.push_back(t);
+            t->owner = p;
+          }
+
+        for (unsigned i = 0; i < _pairs; ++i)
+          {
+            Pipe *p = pipe[2 * i + d];
+            p->tx = p->txs.empty() ? nullptr : p->txs[0];
+          }
+      }
+
+    for (auto *p: pipe)
+      p->lock.unlock();
+
+    // Forwarding may have stopped in between, look for new work.
+    if (_threads)
+      for (unsigned i = 0; i < _pairs; ++i)
+        pipe[2 * i + (rxd ^ 1)]->irq->trigger();
+  }
+
+  /**
+   * Rebalance if a port changed the number of queue pairs it uses.
+   */
+  void check_pairs()
+  {
+    for (unsigned d = 0; d < Nports; ++d)
+      if (port[d]->pairs_gen() != _pairs_gen[d])
+        rebalance(d);
+  }
+
+private:
+  /// Control queue notification of a port, handled by the main thread.
+  struct Ctrl_irq : public L4::Irqep_t<Ctrl_irq>
+  {
+    Sock_pair *s = nullptr;
+    Virtio_net *dev = nullptr;
+    void handle_irq()
+    {
+      dev->handle_ctrl_queue();
+      s->check_pairs();
+    }
+  };
+
+  static void *pipe_thread(void *arg)
+  {
+    Pipe *p = static_cast<Pipe *>(arg);
+
+    L4Re::chksys(p->irq->bind_thread(Pthread::L4::cap(pthread_self()), 0),
+                 "Bind pipe IRQ");
+
+    for (;;)
+      {
+        Pipe *owner;
+        {
+          std::lock_guard<std::mutex> g(p->lock);
+          forward(&p, 1);
+          owner = p->home->owner;
+        }
+
+        // The notification may be for the transmit queue of our queue pair
+        // that is forwarded by another pipe.
+        if (owner != p)
+          owner->irq->trigger();
+
+        if (p->reverse->rx_starved.exchange(false))
+          p->reverse->irq->trigger();
+
+        // A port was reset or selected a different number of queue pairs.
+        p->link->check_pairs();
+
+        if (l4_ipc_error(p->irq->receive(), l4_utcb()))
+          continue;
+      }
+
+    return nullptr;
+  }
+
+  unsigned _pairs;
+  /// Last Virtio_net::pairs_gen() of each port the pipes are balanced for.
+  std::atomic<unsigned> _pairs_gen[Nports] = { {~0U}, {~0U} };
+  Ctrl_irq _ctrl_irq[Nports];
+  bool _threads = false;
 };
 
 #ifdef CONFIG_STATS
@@ -1104,10 +1691,12 @@ run(int argc, char *const *argv)
   int opt, index;
   int vq_max_num = 0x100; // default value for data queues
   int poll_interval = 0;
+  int queue_pairs = 1;
+  bool threads = false;
 
   printf("Hello from l4vio_net_p2p\n");
 
-  while( (opt = getopt_long(argc, argv, "s:p:d:", options, &index)) != -1)
+  while( (opt = getopt_long(argc, argv, "s:p:d:tq:", options, &index)) != -1)
     {
       switch (opt)
         {
@@ -1139,12 +1728,36 @@ run(int argc, char *const *argv)
             trusted_dataspaces->push_back(ds);
             break;
           }
+        case 't':
+          threads = true;
+          break;
+        case 'q':
+          if (!parse_int_optstring(optarg, &queue_pairs) || queue_pairs < 1
+              || queue_pairs > Max_queue_pairs)
+            {
+              printf("Number of queue pairs must be between 1 and %d. "
+                     "Invalid value: %s\n", Max_queue_pairs, optarg);
+              return 1;
+            }
+          break;
         }
     }
 
+  // Queue pairs are forwarded by threads of their own.
+  if (queue_pairs > 1)
+    threads = true;
+
+  if (threads && poll_interval > 0)
+    {
+      printf("Polling mode and forwarding threads are mutually exclusive.\n");
+      return 1;
+    }
+
   printf("Max number of buffers in virtqueue: %i\n", vq_max_num);
+  if (queue_pairs > 1)
+    printf("Queue pairs per port: %i\n", queue_pairs);
 
-  Sock_pair *s = new Sock_pair(vq_max_num);
+  Sock_pair *s = new Sock_pair(vq_max_num, queue_pairs);
   L4::Cap<void> cap = server.registry()->register_obj(s, "svr");
   server.registry()->register_irq_obj(s->irq_object());
   if (!cap.is_valid())
@@ -1153,6 +1766,9 @@ run(int argc, char *const *argv)
   if (poll_interval > 0)
     s->enable_timer(poll_interval);
 
+  if (threads)
+    s->enable_threads();
+
 #ifdef CONFIG_STATS
   pthread_t stats_thread;
   pthread_create(&stats_thread, NULL, stats_thread_loop, s);